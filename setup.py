@@ -1,11 +1,38 @@
 import sys
-import cpufeature
+import platform
 from pathlib import Path
 from glob import glob
 from setuptools import setup
 from pybind11.setup_helpers import Pybind11Extension, build_ext
 
 WIN = sys.platform.startswith("win32")
+X86 = platform.machine().lower() in ("x86_64", "amd64", "i386", "i686", "x86")
+
+# The kernels are compiled once per instruction set and the best one is
+# picked at runtime (src/dispatch), so the same wheel runs on any x86 cpu.
+# Every file is built with the baseline flags - the kernels select their
+# instruction set themselves (src/dispatch/shellCalcISA.hpp).
+if WIN:
+    base_args = ["/std:c++17", "/O2", "/D_USE_MATH_DEFINES"]
+else:
+    base_args = ["-std=c++17", "-O3"]
+
+isa_names = ["sse4", "avx2", "avx512"] if X86 else []
+sources = ["src/dispatch/shellCalc_generic.cpp",
+           "src/dispatch/shellCalcDispatch.cpp"]
+sources += ["src/dispatch/shellCalc_{}.cpp".format(isa) for isa in isa_names]
+if X86:
+    sources.append("src/version2/instrset_detect.cpp")
+
+libraries = [
+    ("wows_shell_dispatch", {
+        "sources": sources,
+        "include_dirs": ["src"],
+        "macros": [("WOWS_SHELL_DISPATCH_" + isa.upper(), "1")
+                   for isa in isa_names],
+        "cflags": base_args,
+    }),
+]
 
 ext_modules = [
     Pybind11Extension(
@@ -16,15 +43,6 @@ ext_modules = [
     ),
 ]
 
-cxx_compile_args = ext_modules[0].extra_compile_args
-if WIN:
-    if cpufeature.CPUFeature['AVX2']:
-        cxx_compile_args.append('/arch:AVX2')
-    elif cpufeature.CPUFeature['AVX']:
-        cxx_compile_args.append('/arch:AVX')
-else:
-    cxx_compile_args.append('-march=native')
-
 with open("README.md", "r", encoding="utf-8") as fh:
     long_description = fh.read()
 
@@ -36,5 +54,6 @@ setup(
     long_description_content_type="text/markdown",
     url="https://github.com/jcw780/wows_shell",
     cmdclass={"build_ext": build_ext},
+    libraries=libraries,
     ext_modules=ext_modules,
 )
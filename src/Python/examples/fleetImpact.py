@@ -0,0 +1,38 @@
+from wows_shell import *
+
+import numpy as np
+
+# A fleet array of shellParams rows has to give the same impact tables as
+# calculating every shell on its own
+
+fleet = np.array([
+    [.460, 780, .292, 1460, 2574, 6, .033, 76, 45, 60, 0],
+    [.406, 762, .352, 1225, 2520, 6, .033, 69, 45, 60, 0],
+    [.203, 853, .3, 118, 0, 6, .033, 0, 0, 0, 0],
+    [.152, 950, .4, 55, 0, 6, .033, 0, 0, 0, 0],
+    [.381, 731, .321, 879, 2215, 6, .033, 70, 45, 60, 0],
+])
+
+c = shellCalc()
+c.setMax(25)
+
+result = calcFleetImpactRungeKutta4(c, fleet)
+
+for i, row in enumerate(fleet):
+    s = shell(*row, 'shell {}'.format(i))
+    c.calcImpactRungeKutta4(s)
+    single = s.getImpact()
+    assert result.shape == (len(fleet),) + single.shape
+    assert np.array_equal(result[i], single)
+
+# An empty fleet is not an error
+assert calcFleetImpactRungeKutta4(c, fleet[:0]).shape[0] == 0
+
+for wrong in (fleet[:, :10], fleet[0], fleet.reshape(1, len(fleet), 11)):
+    try:
+        calcFleetImpactRungeKutta4(c, wrong)
+    except ValueError:
+        pass
+    else:
+        assert False, 'shape {} accepted'.format(wrong.shape)
+print('ok')
@@ -65,6 +65,24 @@ impacts['Forward Euler .001'] = s.getImpact()
 c.calcImpactRungeKutta2(s)
 impacts['RungeKutta2 .001'] = s.getImpact()
 
+c.setDtMin(.02)
+c.calcImpactDormandPrince45(s)
+impacts['DormandPrince45 .02'] = s.getImpact()
+
+c.setDtMin(.001)
+c.calcImpactDormandPrince45(s)
+impacts['DormandPrince45 .001'] = s.getImpact()
+
+c.setExactImpact(True)
+c.setDtMin(.1)
+c.calcImpactRungeKutta4(s)
+impacts['RungeKutta4 .1 Exact Impact'] = s.getImpact()
+
+c.setDtMin(.02)
+c.calcImpactDormandPrince45(s)
+impacts['DormandPrince45 .02 Exact Impact'] = s.getImpact()
+c.setExactImpact(False)
+
 c.setDtMin(.0001)
 c.calcImpactRungeKutta4(s)
 reference = s.getImpact()
@@ -0,0 +1,56 @@
+from wows_shell import *
+
+import os
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+# Calculations release the GIL - N shells on N Python threads should take
+# about as long as one shell on one thread, given N cores
+
+# Cores this process may run on
+if hasattr(os, 'sched_getaffinity'):
+    threads = len(os.sched_getaffinity(0))
+else:
+    threads = os.cpu_count()
+# Least throughput per thread that still counts as scaling - serialized on
+# the GIL N threads would get 1 / N of it
+minEfficiency = .6
+params = shellParams(.460, 780, .292, 1460, 2574, 6, .033, 76, 45, 60, 0)
+
+c = shellCalc()
+# One native thread per call - the scaling comes from the Python threads
+c.setThreadBudget(1)
+c.setDtMin(.001)
+# The cache is off by default, so identical shells are all computed
+
+
+def run(shells):
+    for s in shells:
+        c.calcImpactRungeKutta4(s)
+        c.calcAngles(s, 70, 0)
+
+
+def timed(shellsPerThread):
+    start = time.perf_counter()
+    with ThreadPoolExecutor(max_workers=len(shellsPerThread)) as executor:
+        list(executor.map(run, shellsPerThread))
+    return time.perf_counter() - start
+
+
+single = [shell(params, 'Yamato')]
+reference = timed([single])
+print('1 shell on 1 thread: {:.3f} s'.format(reference))
+for n in range(2, threads + 1):
+    shells = [[shell(params, 'Yamato {}'.format(i))] for i in range(n)]
+    elapsed = timed(shells)
+    throughput = n * reference / elapsed
+    print('{0} shells on {0} threads: {1:.3f} s - {2:.2f}x throughput'.format(
+        n, elapsed, throughput))
+    assert all(
+        (s[0].getImpact() == single[0].getImpact()).all() for s in shells)
+    assert throughput >= minEfficiency * n, \
+        '{} threads only reached {:.2f}x throughput'.format(n, throughput)
+
+if threads == 1:
+    print('1 core - scaling not checked')
+print('ok')
@@ -0,0 +1,45 @@
+from wows_shell import *
+
+import threading
+
+# Two Python threads calculating on one calculator while a third changes its
+# settings and reads a shell being calculated - checks the GIL is released
+# and retaken without deadlocking and that the results match a serial run
+
+params = shellParams(.460, 780, .292, 1460, 2574, 6, .033, 76, 45, 60, 0)
+
+c = shellCalc()
+c.setThreadBudget(2)
+c.setMax(20)
+
+reference = shell(params, 'Reference')
+c.calcImpactRungeKutta4(reference)
+c.calcAngles(reference, 70, 0)
+
+
+def calculate(s):
+    for _ in range(20):
+        c.calcImpactRungeKutta4(s)
+        c.calcAngles(s, 70, 0)
+
+
+def interfere(s):
+    for _ in range(50):
+        c.setMax(20)
+        c.clearCache()
+        s.getImpact()
+
+
+shells = [shell(params, 'Yamato {}'.format(i)) for i in range(2)]
+threads = [threading.Thread(target=calculate, args=(s,)) for s in shells]
+threads.append(threading.Thread(target=interfere, args=(shells[0],)))
+for t in threads:
+    t.start()
+for t in threads:
+    t.join(timeout=60)
+    assert not t.is_alive(), 'deadlocked'
+
+for s in shells:
+    assert (s.getImpact() == reference.getImpact()).all()
+    assert (s.getAngles() == reference.getAngles()).all()
+print('ok')
@@ -1,7 +1,10 @@
 /*cppimport
 <%
 cfg['compiler_args'] = ['-std=c++17', '/std:c++17', '-Ofast', '/Ot',
-'-march=native','/arch:AVX2', '/D_USE_MATH_DEFINES', '/GL']
+'/D_USE_MATH_DEFINES', '/GL']
+# Builds the generic kernels only - setup.py builds every instruction set
+cfg['sources'] = ['../dispatch/shellCalc_generic.cpp',
+'../dispatch/shellCalcDispatch.cpp']
 setup_pybind11(cfg)
 %>
 */
@@ -23,16 +26,31 @@ https://github.com/pybind/pybind11/issues/1212
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <mutex>
+#include <shared_mutex>
 #include <sstream>
 #include <string>
 #include <utility>
 
-#include "../shellCPP.hpp"
+#include "../dispatch/shellCalcDispatch.hpp"
 
 namespace wows_shell {
 class shellPython {
    public:
     shell s;
+    // Guards s - calculations hold it with the GIL released
+    mutable std::mutex m;
+
+    // Waits for calculations on this shell without holding the GIL
+    std::unique_lock<std::mutex> lock() const {
+        std::unique_lock<std::mutex> lk(m, std::try_to_lock);
+        if (!lk.owns_lock()) {
+            pybind11::gil_scoped_release release;
+            lk.lock();
+        }
+        return lk;
+    }
+
     shellPython(const double caliber, const double v0, const double cD,
                 const double mass, const double krupp,
                 const double normalization, const double fuseTime,
@@ -64,24 +82,29 @@ class shellPython {
                      "shell.setValues(args...) is deprecated, use "
                      "shell.setValues(shellParams(args...), name) instead.",
                      1);
+        auto lk = lock();
         s.setValues(caliber, v0, cD, mass, krupp, normalization, fuseTime,
                     threshold, ricochet0, ricochet1, nonAP, name);
     }
     void setValues(const shellParams &sp, const std::string &name) {
+        auto lk = lock();
         s.setValues(sp, name);
     }
     void setValues(const shellParams &sp, const dispersionParams &dp,
                    const std::string &name) {
+        auto lk = lock();
         s.setValues(sp, dp, name);
     }
 
     pybind11::dict maxDist() {
+        auto lk = lock();
         auto res = s.maxDist();
         return pybind11::dict(pybind11::arg("index") = std::get<0>(res),
                               pybind11::arg("distance") = std::get<1>(res));
     }
 
     void printImpact() {
+        auto lk = lock();
         if (s.completedImpact) {
             s.printImpactData();
         } else {
@@ -90,6 +113,7 @@ class shellPython {
     }
 
     void printAngles() {
+        auto lk = lock();
         if (s.completedAngles) {
             s.printAngleData();
         } else {
@@ -98,6 +122,7 @@ class shellPython {
     }
 
     void printDispersion() {
+        auto lk = lock();
         if (s.completedDispersion) {
             s.printDispersionData();
         } else {
@@ -106,6 +131,7 @@ class shellPython {
     }
 
     void printPostPen() {
+        auto lk = lock();
         if (s.completedPostPen) {
             s.printPostPenData();
         } else {
@@ -114,10 +140,40 @@ class shellPython {
     }
 
     double interpolateDistanceImpact(double distance, unsigned int impact) {
+        auto lk = lock();
         return s.interpolateDistanceImpact(distance, impact);
     }
 
+    // (distance, column) array in one call - see shell
+    pybind11::array_t<double> interpolateDistanceImpacts(
+        const pybind11::array_t<double, pybind11::array::c_style |
+                                            pybind11::array::forcecast>
+            &distances,
+        const std::vector<uint32_t> &columns) {
+        if (distances.ndim() != 1) {
+            throw pybind11::value_error("distances must be one dimensional");
+        }
+        for (const uint32_t column : columns) {
+            if (column >= impact::maxColumns) {
+                throw pybind11::value_error("column out of range");
+            }
+        }
+        const std::size_t n = distances.shape(0);
+        pybind11::array_t<double> result(
+            std::array<std::size_t, 2>{n, columns.size()});
+        const double *in = distances.data();
+        double *out = result.mutable_data();
+        {
+            auto lk = lock();
+            pybind11::gil_scoped_release release;
+            s.interpolateDistanceImpact(in, n, columns.data(), columns.size(),
+                                        out);
+        }
+        return result;
+    }
+
     pybind11::array_t<double> getImpact(bool owned = true) {
+        auto lk = lock();
         if (s.completedImpact) {
             constexpr std::size_t sT = sizeof(double);
             std::array<size_t, 2> shape = {impact::maxColumns, s.impactSize},
@@ -135,6 +191,7 @@ class shellPython {
     }
 
     pybind11::array_t<double> getAngles(bool owned = true) {
+        auto lk = lock();
         if (s.completedAngles) {
             constexpr std::size_t sT = sizeof(double);
             std::array<size_t, 2> shape = {angle::maxColumns, s.impactSize},
@@ -152,6 +209,7 @@ class shellPython {
     }
 
     pybind11::array_t<double> getDispersion(bool owned = true) {
+        auto lk = lock();
         if (s.completedDispersion) {
             constexpr std::size_t sT = sizeof(double);
             std::array<size_t, 2> shape = {dispersion::maxColumns,
@@ -170,6 +228,7 @@ class shellPython {
     }
 
     pybind11::array_t<double> getPostPen(bool owned = true) {
+        auto lk = lock();
         if (s.completedPostPen) {
             constexpr std::size_t sT = sizeof(double);
             std::size_t numAngles = s.postPenSize / s.impactSize;
@@ -191,12 +250,24 @@ class shellPython {
 };
 
 std::string generateShellPythonHash(const shellPython &s) {
+    auto lk = s.lock();
     return generateHash(s.s);
 }
 
-class shellCalcPython : public shellCalc {
+// Calculations run with the GIL released and may be called from several
+// Python threads at once - each holds the settings lock shared and the lock
+// of its shell
+class shellCalcPython : public shellCalcDispatch {
    public:
+    std::shared_mutex settings;
+
     shellCalcPython() = default;
+    shellCalcPython(const instructionSet isa) : shellCalcDispatch(isa) {}
+    // Shares the thread pool of other - see setThreadBudget
+    shellCalcPython(const shellCalcPython &other,
+                    const std::size_t threadBudget)
+        : shellCalcDispatch(other.get_instructionSet(), other.get_threadPool(),
+                            threadBudget) {}
 
     /*void setMax(const double max) { calc.set_max(max); }
     void setMin(const double min) { calc.set_min(min); }
@@ -208,30 +279,116 @@ class shellCalcPython : public shellCalc {
     void setYf0(const double yf0) { calc.set_yf0(yf0); }
     void setDtf(const double dtf) { calc.set_dtf(dtf); }*/
 
-    template <numerical Numerical>
+    template <numerical Numerical, bool Hybrid = false>
     void calcImpact(shellPython &sp) {
-        calculateImpact<false, Numerical, false>(sp.s);
+        std::shared_lock<std::shared_mutex> lk(settings);
+        std::lock_guard<std::mutex> shellLock(sp.m);
+        calculateImpact<false, Numerical, Hybrid>(sp.s);
+    }
+
+    template <numerical Numerical>
+    void calcImpactDistances(shellPython &sp,
+                             const std::vector<double> &distances) {
+        std::shared_lock<std::shared_mutex> lk(settings);
+        std::lock_guard<std::mutex> shellLock(sp.m);
+        calculateImpactDistances<false, Numerical, false>(sp.s, distances);
+    }
+
+    template <numerical Numerical>
+    void calcImpactAnglesDispersion(shellPython &sp, const double thickness,
+                                    const double inclination,
+                                    const std::size_t verticalType_i) {
+        dispersion::verticalTypes verticalType =
+            static_cast<dispersion::verticalTypes>(verticalType_i);
+        std::shared_lock<std::shared_mutex> lk(settings);
+        std::lock_guard<std::mutex> shellLock(sp.m);
+        calculateImpactAnglesDispersion<false, Numerical, false>(
+            sp.s, thickness, inclination, verticalType);
     }
 
     void calcAngles(shellPython &sp, const double thickness,
                     const double inclination) {
+        std::shared_lock<std::shared_mutex> lk(settings);
+        std::lock_guard<std::mutex> shellLock(sp.m);
         calculateAngles(thickness, inclination, sp.s);
     }
 
     void calcDispersion(shellPython &sp, const std::size_t verticalType_i) {
         dispersion::verticalTypes verticalType =
             static_cast<dispersion::verticalTypes>(verticalType_i);
+        std::shared_lock<std::shared_mutex> lk(settings);
+        std::lock_guard<std::mutex> shellLock(sp.m);
         calculateDispersion(verticalType, sp.s);
     }
 
     void calcPostPen(shellPython &sp, const double thickness,
                      const double inclination, std::vector<double> angles,
                      const bool changeDirection, const bool fast) {
+        std::shared_lock<std::shared_mutex> lk(settings);
+        std::lock_guard<std::mutex> shellLock(sp.m);
         calculatePostPen(thickness, inclination, sp.s, angles, changeDirection,
                          fast);
     }
 };
 
+// Impact tables of a fleet without per-shell Python objects - each row of
+// params holds the 11 shellParams fields. The shells are computed together
+// with calc's settings and returned as (shell, impact column, launch angle).
+template <numerical Numerical>
+pybind11::array_t<double> calcFleetImpact(
+    shellCalcPython &calc,
+    const pybind11::array_t<double, pybind11::array::c_style |
+                                        pybind11::array::forcecast> &params) {
+    constexpr std::size_t fields = 11;
+    if (params.ndim() != 2 || params.shape(1) != fields) {
+        throw pybind11::value_error("params must have shape (shells, 11)");
+    }
+    const std::size_t n = params.shape(0);
+    const double *p = params.data();
+    std::vector<shell> fleet(n);
+    {
+        pybind11::gil_scoped_release release;
+        for (std::size_t i = 0; i < n; ++i) {
+            const double *row = p + i * fields;
+            fleet[i].setValues(
+                shellParams(row[0], row[1], row[2], row[3], row[4], row[5],
+                            row[6], row[7], row[8], row[9], row[10]),
+                "");
+        }
+        std::shared_lock<std::shared_mutex> lk(calc.settings);
+        calc.calculateImpact<false, Numerical, false>(fleet.data(),
+                                                      fleet.data() + n);
+    }
+    // Rows depend only on the calculator's launch angle range
+    const std::size_t rows = n ? fleet[0].impactSize : 0;
+    pybind11::array_t<double> result(
+        std::array<std::size_t, 3>{n, impact::maxColumns, rows});
+    double *out = result.mutable_data();
+    {
+        pybind11::gil_scoped_release release;
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < impact::maxColumns; ++j) {
+                std::copy_n(fleet[i].get_impactPtr(0, j), rows,
+                            out + (i * impact::maxColumns + j) * rows);
+            }
+        }
+    }
+    return result;
+}
+
+// Calculator setter that waits for running calculations - they hold the
+// settings lock shared
+template <auto Setter>
+struct exclusiveSetter;
+template <typename Calc, typename... Args, void (Calc::*Setter)(Args...)>
+struct exclusiveSetter<Setter> {
+    static void set(shellCalcPython &calc, Args... args) {
+        pybind11::gil_scoped_release release;
+        std::unique_lock<std::shared_mutex> lk(calc.settings);
+        (calc.*Setter)(args...);
+    }
+};
+
 template <typename Input, typename Keys, typename Output, typename KeyGenerator>
 void extractDictToArray(Input &input, Keys &keys, Output &output,
                         KeyGenerator keyGenerator) {
@@ -311,6 +468,7 @@ void setDispersionParamsFromKV(dispersionParams &dp, KV &input) {
 }
 
 PYBIND11_MODULE(wows_shell, m) {
+    using releaseGIL = pybind11::call_guard<pybind11::gil_scoped_release>;
     pybind11::class_<shellParams>(m, "shellParams")
         .def(pybind11::init<double, double, double, double, double, double,
                             double, double, double, double, double>())
@@ -376,6 +534,9 @@ PYBIND11_MODULE(wows_shell, m) {
         .def("maxDist", &shellPython::maxDist)
         .def("interpolateDistanceImpact",
              &shellPython::interpolateDistanceImpact)
+        .def("interpolateDistanceImpacts",
+             &shellPython::interpolateDistanceImpacts,
+             pybind11::arg("distances"), pybind11::arg("columns"))
         .def("getImpact", &shellPython::getImpact,
              pybind11::arg("owned") = true)
         .def("getAngles", &shellPython::getAngles,
@@ -392,27 +553,120 @@ PYBIND11_MODULE(wows_shell, m) {
     pybind11::class_<shellCalcPython>(m, "shellCalc",
                                       pybind11::buffer_protocol())
         .def(pybind11::init())
-        .def("setMax", &shellCalcPython::set_max)
-        .def("setMin", &shellCalcPython::set_min)
-        .def("setPrecision", &shellCalcPython::set_precision)
-        .def("setX0", &shellCalcPython::set_x0)
-        .def("setY0", &shellCalcPython::set_y0)
-        .def("setDtMin", &shellCalcPython::set_dt_min)
-        .def("setXf0", &shellCalcPython::set_xf0)
-        .def("setYf0", &shellCalcPython::set_yf0)
-        .def("setDtf", &shellCalcPython::set_dtf)
+        .def(pybind11::init<instructionSet>())
+        .def(pybind11::init<const shellCalcPython &, std::size_t>(),
+             pybind11::arg("sharePool"), pybind11::arg("threadBudget") = 0)
+        .def("getInstructionSet", &shellCalcPython::get_instructionSet)
+        .def("setMax", &exclusiveSetter<&shellCalcPython::set_max>::set)
+        .def("setMin", &exclusiveSetter<&shellCalcPython::set_min>::set)
+        .def("setPrecision",
+             &exclusiveSetter<&shellCalcPython::set_precision>::set)
+        .def("setX0", &exclusiveSetter<&shellCalcPython::set_x0>::set)
+        .def("setY0", &exclusiveSetter<&shellCalcPython::set_y0>::set)
+        .def("setDtMin", &exclusiveSetter<&shellCalcPython::set_dt_min>::set)
+        .def("setTolerance",
+             &exclusiveSetter<&shellCalcPython::set_tolerance>::set)
+        .def("setExactImpact",
+             &exclusiveSetter<&shellCalcPython::set_exactImpact>::set)
+        .def("setLaneRefill",
+             &exclusiveSetter<&shellCalcPython::set_laneRefill>::set)
+        .def("setSolveTolerance",
+             &exclusiveSetter<&shellCalcPython::set_solveTolerance>::set)
+        .def("setHybridHeight",
+             &exclusiveSetter<&shellCalcPython::set_hybridHeight>::set)
+        .def("setHybridScale",
+             &exclusiveSetter<&shellCalcPython::set_hybridScale>::set)
+        .def("setXf0", &exclusiveSetter<&shellCalcPython::set_xf0>::set)
+        .def("setYf0", &exclusiveSetter<&shellCalcPython::set_yf0>::set)
+        .def("setDtf", &exclusiveSetter<&shellCalcPython::set_dtf>::set)
+        .def("setCacheSize",
+             &exclusiveSetter<&shellCalcPython::set_cacheSize>::set)
+        .def("clearCache", &exclusiveSetter<&shellCalcPython::clearCache>::set)
+        .def("getCacheHits", &shellCalcPython::get_cacheHits)
+        .def("getCacheMisses", &shellCalcPython::get_cacheMisses)
+        .def("setThreadBudget",
+             &exclusiveSetter<&shellCalcPython::set_threadBudget>::set)
+        .def("setMinTasksPerThread",
+             &exclusiveSetter<&shellCalcPython::set_minTasksPerThread>::set)
         .def("calcImpactForwardEuler",
-             &shellCalcPython::calcImpact<numerical::forwardEuler>)
+             &shellCalcPython::calcImpact<numerical::forwardEuler>,
+             releaseGIL())
         .def("calcImpactAdamsBashforth5",
-             &shellCalcPython::calcImpact<numerical::adamsBashforth5>)
+             &shellCalcPython::calcImpact<numerical::adamsBashforth5>,
+             releaseGIL())
         .def("calcImpactRungeKutta2",
-             &shellCalcPython::calcImpact<numerical::rungeKutta2>)
+             &shellCalcPython::calcImpact<numerical::rungeKutta2>, releaseGIL())
         .def("calcImpactRungeKutta4",
-             &shellCalcPython::calcImpact<numerical::rungeKutta4>)
-        .def("calcAngles", &shellCalcPython::calcAngles)
-        .def("calcDispersion", &shellCalcPython::calcDispersion)
-        .def("calcPostPen", &shellCalcPython::calcPostPen);
+             &shellCalcPython::calcImpact<numerical::rungeKutta4>, releaseGIL())
+        .def("calcImpactDormandPrince45",
+             &shellCalcPython::calcImpact<numerical::dormandPrince45>,
+             releaseGIL())
+        .def("calcImpactHybridForwardEuler",
+             &shellCalcPython::calcImpact<numerical::forwardEuler, true>,
+             releaseGIL())
+        .def("calcImpactHybridRungeKutta2",
+             &shellCalcPython::calcImpact<numerical::rungeKutta2, true>,
+             releaseGIL())
+        .def("calcImpactHybridRungeKutta4",
+             &shellCalcPython::calcImpact<numerical::rungeKutta4, true>,
+             releaseGIL())
+        .def("calcImpactDistancesForwardEuler",
+             &shellCalcPython::calcImpactDistances<numerical::forwardEuler>,
+             releaseGIL())
+        .def("calcImpactDistancesAdamsBashforth5",
+             &shellCalcPython::calcImpactDistances<numerical::adamsBashforth5>,
+             releaseGIL())
+        .def("calcImpactDistancesRungeKutta2",
+             &shellCalcPython::calcImpactDistances<numerical::rungeKutta2>,
+             releaseGIL())
+        .def("calcImpactDistancesRungeKutta4",
+             &shellCalcPython::calcImpactDistances<numerical::rungeKutta4>,
+             releaseGIL())
+        .def("calcImpactDistancesDormandPrince45",
+             &shellCalcPython::calcImpactDistances<numerical::dormandPrince45>,
+             releaseGIL())
+        .def("calcImpactAnglesDispersionForwardEuler",
+             &shellCalcPython::calcImpactAnglesDispersion<
+                 numerical::forwardEuler>, releaseGIL())
+        .def("calcImpactAnglesDispersionAdamsBashforth5",
+             &shellCalcPython::calcImpactAnglesDispersion<
+                 numerical::adamsBashforth5>, releaseGIL())
+        .def("calcImpactAnglesDispersionRungeKutta2",
+             &shellCalcPython::calcImpactAnglesDispersion<
+                 numerical::rungeKutta2>, releaseGIL())
+        .def("calcImpactAnglesDispersionRungeKutta4",
+             &shellCalcPython::calcImpactAnglesDispersion<
+                 numerical::rungeKutta4>, releaseGIL())
+        .def("calcImpactAnglesDispersionDormandPrince45",
+             &shellCalcPython::calcImpactAnglesDispersion<
+                 numerical::dormandPrince45>, releaseGIL())
+        .def("calcAngles", &shellCalcPython::calcAngles, releaseGIL())
+        .def("calcDispersion", &shellCalcPython::calcDispersion, releaseGIL())
+        .def("calcPostPen", &shellCalcPython::calcPostPen, releaseGIL());
     // Enums
+    pybind11::enum_<instructionSet>(m, "instructionSet")
+        .value("generic", instructionSet::generic)
+        .value("sse4", instructionSet::sse4)
+        .value("avx2", instructionSet::avx2)
+        .value("avx512", instructionSet::avx512);
+    m.def("detectInstructionSet", &detectInstructionSet);
+
+    m.def("calcFleetImpactForwardEuler",
+          &calcFleetImpact<numerical::forwardEuler>, pybind11::arg("calc"),
+          pybind11::arg("params"));
+    m.def("calcFleetImpactAdamsBashforth5",
+          &calcFleetImpact<numerical::adamsBashforth5>, pybind11::arg("calc"),
+          pybind11::arg("params"));
+    m.def("calcFleetImpactRungeKutta2",
+          &calcFleetImpact<numerical::rungeKutta2>, pybind11::arg("calc"),
+          pybind11::arg("params"));
+    m.def("calcFleetImpactRungeKutta4",
+          &calcFleetImpact<numerical::rungeKutta4>, pybind11::arg("calc"),
+          pybind11::arg("params"));
+    m.def("calcFleetImpactDormandPrince45",
+          &calcFleetImpact<numerical::dormandPrince45>, pybind11::arg("calc"),
+          pybind11::arg("params"));
+
     pybind11::enum_<impact::impactIndices>(m, "impactIndices",
                                            pybind11::arithmetic())
         .value("distance", impact::impactIndices::distance)
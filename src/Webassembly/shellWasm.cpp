@@ -377,13 +377,39 @@ class shellCalcWasm : public shellCalc {
     void setX0(const double x0) { set_x0(x0); }
     void setY0(const double y0) { set_y0(y0); }
     void setDtMin(const double dt) { set_dt_min(dt); }
+    void setTolerance(const double tolerance) { set_tolerance(tolerance); }
+    void setExactImpact(const bool exactImpact) {
+        set_exactImpact(exactImpact);
+    }
+    void setLaneRefill(const bool laneRefill) { set_laneRefill(laneRefill); }
+    void setSolveTolerance(const double solveTolerance) {
+        set_solveTolerance(solveTolerance);
+    }
+    void setHybridHeight(const double hybridHeight) {
+        set_hybridHeight(hybridHeight);
+    }
+    void setHybridScale(const double hybridScale) {
+        set_hybridScale(hybridScale);
+    }
     void setXf0(const double xf0) { set_xf0(xf0); }
     void setYf0(const double yf0) { set_yf0(yf0); }
     void setDtf(const double dtf) { set_dtf(dtf); }
+    void setCacheSize(const std::size_t cacheSize) {
+        set_cacheSize(cacheSize);
+    }
+    std::size_t getCacheHits() const { return get_cacheHits(); }
+    std::size_t getCacheMisses() const { return get_cacheMisses(); }
 
-    template <numerical Numerical>
+    template <numerical Numerical, bool Hybrid = false>
     void calcImpact(shellWasm &sp) {
-        calculateImpact<false, Numerical, false>(sp.s);
+        calculateImpact<false, Numerical, Hybrid>(sp.s);
+    }
+
+    template <numerical Numerical>
+    void calcImpactDistances(shellWasm &sp, emscripten::val distancesVal) {
+        std::vector<double> distances =
+            emscripten::convertJSArrayToNumberVector<double>(distancesVal);
+        calculateImpactDistances<false, Numerical, false>(sp.s, distances);
     }
 
     void calcAngles(shellWasm &sp, const double thickness,
@@ -590,9 +616,19 @@ EMSCRIPTEN_BINDINGS(shellWasm) {
         .function("setX0", &shellCalcWasm::setX0)
         .function("setY0", &shellCalcWasm::setY0)
         .function("setDtMin", &shellCalcWasm::setDtMin)
+        .function("setTolerance", &shellCalcWasm::setTolerance)
+        .function("setExactImpact", &shellCalcWasm::setExactImpact)
+        .function("setLaneRefill", &shellCalcWasm::setLaneRefill)
+        .function("setSolveTolerance", &shellCalcWasm::setSolveTolerance)
+        .function("setHybridHeight", &shellCalcWasm::setHybridHeight)
+        .function("setHybridScale", &shellCalcWasm::setHybridScale)
         .function("setXf0", &shellCalcWasm::setXf0)
         .function("setYf0", &shellCalcWasm::setYf0)
         .function("setDtf", &shellCalcWasm::setDtf)
+        .function("setCacheSize", &shellCalcWasm::setCacheSize)
+        .function("clearCache", &shellCalcWasm::clearCache)
+        .function("getCacheHits", &shellCalcWasm::getCacheHits)
+        .function("getCacheMisses", &shellCalcWasm::getCacheMisses)
         .function("calcImpact",
                   &shellCalcWasm::calcImpact<numerical::forwardEuler>)
         .function("calcImpactAdamsBashforth5",
@@ -603,6 +639,26 @@ EMSCRIPTEN_BINDINGS(shellWasm) {
                   &shellCalcWasm::calcImpact<numerical::rungeKutta2>)
         .function("calcImpactRungeKutta4",
                   &shellCalcWasm::calcImpact<numerical::rungeKutta4>)
+        .function("calcImpactDormandPrince45",
+                  &shellCalcWasm::calcImpact<numerical::dormandPrince45>)
+        .function("calcImpactHybridForwardEuler",
+                  &shellCalcWasm::calcImpact<numerical::forwardEuler, true>)
+        .function("calcImpactHybridRungeKutta2",
+                  &shellCalcWasm::calcImpact<numerical::rungeKutta2, true>)
+        .function("calcImpactHybridRungeKutta4",
+                  &shellCalcWasm::calcImpact<numerical::rungeKutta4, true>)
+        .function("calcImpactDistancesForwardEuler",
+                  &shellCalcWasm::calcImpactDistances<numerical::forwardEuler>)
+        .function(
+            "calcImpactDistancesAdamsBashforth5",
+            &shellCalcWasm::calcImpactDistances<numerical::adamsBashforth5>)
+        .function("calcImpactDistancesRungeKutta2",
+                  &shellCalcWasm::calcImpactDistances<numerical::rungeKutta2>)
+        .function("calcImpactDistancesRungeKutta4",
+                  &shellCalcWasm::calcImpactDistances<numerical::rungeKutta4>)
+        .function(
+            "calcImpactDistancesDormandPrince45",
+            &shellCalcWasm::calcImpactDistances<numerical::dormandPrince45>)
         .function("calcAngles", &shellCalcWasm::calcAngles)
         .function("calcDispersion", &shellCalcWasm::calcDispersion)
         .function("calcPostPen", &shellCalcWasm::calcPostPen);
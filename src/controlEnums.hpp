@@ -33,8 +33,40 @@ using indexT = typename std::underlying_type<impactIndices>::type;
 static_assert(toUnderlying(impactIndices::effectivePenetrationDeckNormalized) ==
                   (maxColumns - 1),
               "Invalid standard columns");
+
+// Bit mask of impactIndices - selects the impact columns that are computed
+using columnMask = std::uint32_t;
+constexpr columnMask column(const impactIndices index) {
+    return columnMask(1) << toUnderlying(index);
+}
+template <typename... Indices>
+constexpr columnMask columns(const Indices... indices) {
+    return (column(indices) | ...);
+}
+constexpr bool hasColumn(const columnMask mask, const impactIndices index) {
+    return (mask & column(index)) != 0;
+}
+static constexpr columnMask allColumns = (columnMask(1) << maxColumns) - 1;
+static constexpr columnMask fitColumns = (columnMask(1) << maxColumnsFit) - 1;
+// Written by the trajectory calculation itself - always computed
+static constexpr columnMask trajectoryColumns =
+    columns(impactIndices::distance, impactIndices::launchAngle);
 }  // namespace impact
 
+// Groups of shell parameters by how much of the impact data they change
+// trajectory:  v0, caliber, mass, cD - everything
+// penetration: krupp, normalization, nonAP - only the penetration columns
+// Fusing, ricochet and dispersion parameters leave the impact data as is
+namespace parameters {
+enum class groups { trajectory, penetration };
+using groupMask = std::uint8_t;
+constexpr groupMask group(const groups g) {
+    return groupMask(1) << toUnderlying(g);
+}
+static constexpr groupMask allGroups =
+    group(groups::trajectory) | group(groups::penetration);
+}  // namespace parameters
+
 namespace angle {
 static constexpr std::size_t maxColumns = 8;
 enum class angleIndices {
@@ -89,7 +121,8 @@ enum class numerical {
     forwardEuler,
     rungeKutta2,
     rungeKutta4,
-    adamsBashforth5
+    adamsBashforth5,
+    dormandPrince45
 };
 
 template <numerical Numerical>
@@ -100,4 +133,31 @@ static constexpr bool isMultistep() {
         return false;
     }
 }
+
+template <numerical Numerical>
+static constexpr bool isAdaptive() {
+    if constexpr (Numerical == numerical::dormandPrince45) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+// Which integration steps are kept when recording trajectories - the launch
+// and final (impact) points are always kept
+// all:      every step
+// stride:   every recordStride-th step
+// spacing:  steps at least recordSpacing m from the last kept point
+// simplify: as few steps as possible with the polyline through them within
+//           recordTolerance m (vertically) of every step
+enum class recording { all, stride, spacing, simplify };
+
+// Instruction sets shellCalc can be compiled for - in order of preference
+enum class instructionSet { generic, sse4, avx2, avx512 };
+
+// How shellCalc evaluates air density at each integration step
+// exact:      barometric formula - a pow per step
+// polynomial: degree 8 Chebyshev fit of the barometric formula over 0 - 15 km
+//             max relative error 2.6e-12 - exact above 15 km
+enum class atmosphere { exact, polynomial };
 }  // namespace wows_shell
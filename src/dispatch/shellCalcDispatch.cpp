@@ -0,0 +1,123 @@
+// Compile without any instruction set flags - this runs before the CPU is
+// known. WOWS_SHELL_DISPATCH_SSE4 / _AVX2 / _AVX512 mark which of the
+// shellCalc_<instruction set>.cpp files are linked in.
+#include "shellCalcDispatch.hpp"
+
+#include <algorithm>
+
+#if defined(WOWS_SHELL_DISPATCH_SSE4) || defined(WOWS_SHELL_DISPATCH_AVX2) || \
+    defined(WOWS_SHELL_DISPATCH_AVX512)
+#define WOWS_SHELL_DISPATCH_X86
+#include "../version2/instrset.h"
+#endif
+
+namespace wows_shell {
+// Defined in shellCalc_<instruction set>.cpp
+namespace generic {
+std::unique_ptr<shellCalcInterface> makeShellCalc(const std::size_t numThreads);
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    std::shared_ptr<utility::threadPool> pool, const std::size_t threadBudget);
+}
+#ifdef WOWS_SHELL_DISPATCH_SSE4
+namespace sse4 {
+std::unique_ptr<shellCalcInterface> makeShellCalc(const std::size_t numThreads);
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    std::shared_ptr<utility::threadPool> pool, const std::size_t threadBudget);
+}
+#endif
+#ifdef WOWS_SHELL_DISPATCH_AVX2
+namespace avx2 {
+std::unique_ptr<shellCalcInterface> makeShellCalc(const std::size_t numThreads);
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    std::shared_ptr<utility::threadPool> pool, const std::size_t threadBudget);
+}
+#endif
+#ifdef WOWS_SHELL_DISPATCH_AVX512
+namespace avx512 {
+std::unique_ptr<shellCalcInterface> makeShellCalc(const std::size_t numThreads);
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    std::shared_ptr<utility::threadPool> pool, const std::size_t threadBudget);
+}
+#endif
+
+instructionSet detectInstructionSet() {
+#ifdef WOWS_SHELL_DISPATCH_X86
+#ifdef VCL_NAMESPACE
+    using namespace VCL_NAMESPACE;
+#endif
+    // 6: SSE4.2, 8: AVX2, 9: AVX512F
+    static const instructionSet detected = []() {
+        const int level = instrset_detect();
+#ifdef WOWS_SHELL_DISPATCH_AVX512
+        if (level >= 9) return instructionSet::avx512;
+#endif
+#ifdef WOWS_SHELL_DISPATCH_AVX2
+        if (level >= 8 && hasFMA3()) return instructionSet::avx2;
+#endif
+#ifdef WOWS_SHELL_DISPATCH_SSE4
+        if (level >= 6) return instructionSet::sse4;
+#endif
+        return instructionSet::generic;
+    }();
+    return detected;
+#else
+    return instructionSet::generic;
+#endif
+}
+
+instructionSet selectInstructionSet(const instructionSet requested) {
+    instructionSet isa = std::min(requested, detectInstructionSet());
+    // Step down past instruction sets that weren't built
+#ifndef WOWS_SHELL_DISPATCH_AVX512
+    if (isa == instructionSet::avx512) isa = instructionSet::avx2;
+#endif
+#ifndef WOWS_SHELL_DISPATCH_AVX2
+    if (isa == instructionSet::avx2) isa = instructionSet::sse4;
+#endif
+#ifndef WOWS_SHELL_DISPATCH_SSE4
+    if (isa == instructionSet::sse4) isa = instructionSet::generic;
+#endif
+    return isa;
+}
+
+std::unique_ptr<shellCalcInterface> makeShellCalc(const instructionSet isa,
+                                                  std::size_t numThreads) {
+    switch (selectInstructionSet(isa)) {
+#ifdef WOWS_SHELL_DISPATCH_AVX512
+        case instructionSet::avx512:
+            return avx512::makeShellCalc(numThreads);
+#endif
+#ifdef WOWS_SHELL_DISPATCH_AVX2
+        case instructionSet::avx2:
+            return avx2::makeShellCalc(numThreads);
+#endif
+#ifdef WOWS_SHELL_DISPATCH_SSE4
+        case instructionSet::sse4:
+            return sse4::makeShellCalc(numThreads);
+#endif
+        default:
+            return generic::makeShellCalc(numThreads);
+    }
+}
+
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    const instructionSet isa, std::shared_ptr<utility::threadPool> pool,
+    const std::size_t threadBudget) {
+    switch (selectInstructionSet(isa)) {
+#ifdef WOWS_SHELL_DISPATCH_AVX512
+        case instructionSet::avx512:
+            return avx512::makeShellCalc(std::move(pool), threadBudget);
+#endif
+#ifdef WOWS_SHELL_DISPATCH_AVX2
+        case instructionSet::avx2:
+            return avx2::makeShellCalc(std::move(pool), threadBudget);
+#endif
+#ifdef WOWS_SHELL_DISPATCH_SSE4
+        case instructionSet::sse4:
+            return sse4::makeShellCalc(std::move(pool), threadBudget);
+#endif
+        default:
+            return generic::makeShellCalc(std::move(pool), threadBudget);
+    }
+}
+}  // namespace wows_shell
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../controlEnums.hpp"
+#include "../shell.hpp"
+#include "shellCalcInterface.hpp"
+
+namespace wows_shell {
+// Best instruction set supported by both this build and the running CPU
+instructionSet detectInstructionSet();
+// Best available instruction set no higher than requested
+instructionSet selectInstructionSet(const instructionSet requested);
+// shellCalc built for selectInstructionSet(isa)
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    instructionSet isa,
+    std::size_t numThreads = std::thread::hardware_concurrency());
+// Same, running on a pool shared with other calculators - see shellCalc
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    instructionSet isa, std::shared_ptr<utility::threadPool> pool,
+    std::size_t threadBudget = 0);
+
+// Same interface as shellCalc but the kernels are chosen when constructed
+// from the instruction sets compiled into the binary - see
+// shellCalcDispatch.cpp
+class shellCalcDispatch {
+   private:
+    instructionSet isa;
+    std::unique_ptr<shellCalcInterface> calc;
+
+   public:
+    shellCalcDispatch(
+        std::size_t numThreads = std::thread::hardware_concurrency())
+        : shellCalcDispatch(detectInstructionSet(), numThreads) {}
+    shellCalcDispatch(
+        const instructionSet isa,
+        std::size_t numThreads = std::thread::hardware_concurrency())
+        : isa(selectInstructionSet(isa)),
+          calc(makeShellCalc(this->isa, numThreads)) {}
+    // Runs on a pool shared with other calculators - threadBudget caps the
+    // threads each of its calls takes from the pool (0 - the whole pool)
+    shellCalcDispatch(std::shared_ptr<utility::threadPool> pool,
+                      std::size_t threadBudget = 0)
+        : shellCalcDispatch(detectInstructionSet(), std::move(pool),
+                            threadBudget) {}
+    shellCalcDispatch(const instructionSet isa,
+                      std::shared_ptr<utility::threadPool> pool,
+                      std::size_t threadBudget = 0)
+        : isa(selectInstructionSet(isa)),
+          calc(makeShellCalc(this->isa, std::move(pool), threadBudget)) {}
+
+    instructionSet get_instructionSet() const noexcept { return isa; }
+
+    void set_max(const double max) { calc->set_max(max); }
+    void set_min(const double min) { calc->set_min(min); }
+    void set_precision(const double precision) {
+        calc->set_precision(precision);
+    }
+    void set_x0(const double x0) { calc->set_x0(x0); }
+    void set_y0(const double y0) { calc->set_y0(y0); }
+    void set_dt_min(const double dt) { calc->set_dt_min(dt); }
+    void set_tolerance(const double tolerance) {
+        calc->set_tolerance(tolerance);
+    }
+    void set_exactImpact(const bool exactImpact) {
+        calc->set_exactImpact(exactImpact);
+    }
+    void set_laneRefill(const bool laneRefill) {
+        calc->set_laneRefill(laneRefill);
+    }
+    void set_solveTolerance(const double solveTolerance) {
+        calc->set_solveTolerance(solveTolerance);
+    }
+    void set_hybridHeight(const double hybridHeight) {
+        calc->set_hybridHeight(hybridHeight);
+    }
+    void set_hybridScale(const double hybridScale) {
+        calc->set_hybridScale(hybridScale);
+    }
+    void set_recordMode(const recording recordMode) {
+        calc->set_recordMode(recordMode);
+    }
+    void set_recordStride(const std::size_t recordStride) {
+        calc->set_recordStride(recordStride);
+    }
+    void set_recordSpacing(const double recordSpacing) {
+        calc->set_recordSpacing(recordSpacing);
+    }
+    void set_recordTolerance(const double recordTolerance) {
+        calc->set_recordTolerance(recordTolerance);
+    }
+    void set_xf0(const double xf0) { calc->set_xf0(xf0); }
+    void set_yf0(const double yf0) { calc->set_yf0(yf0); }
+    void set_dtf(const double dtf) { calc->set_dtf(dtf); }
+    void set_cacheSize(const std::size_t cacheSize) {
+        calc->set_cacheSize(cacheSize);
+    }
+    void clearCache() { calc->clearCache(); }
+    std::size_t get_cacheHits() const { return calc->get_cacheHits(); }
+    std::size_t get_cacheMisses() const { return calc->get_cacheMisses(); }
+    void set_threadBudget(const std::size_t threadBudget) {
+        calc->set_threadBudget(threadBudget);
+    }
+    void set_minTasksPerThread(const std::size_t minTasksPerThread) {
+        calc->set_minTasksPerThread(minTasksPerThread);
+    }
+    std::shared_ptr<utility::threadPool> get_threadPool() const {
+        return calc->get_threadPool();
+    }
+
+    std::size_t calculateAlignmentSize(
+        std::size_t unalignedSize) const noexcept {
+        return calc->calculateAlignmentSize(unalignedSize);
+    }
+
+    template <auto Numerical, bool Hybrid>
+    void calculateImpact(
+        shell &s, bool addTraj,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        calc->calculateImpact(s, Numerical, addTraj, Hybrid, nThreads);
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void calculateImpact(
+        shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        calc->calculateImpact(s, Numerical, AddTraj, Hybrid, nThreads);
+    }
+
+    // Shells [first, last) scheduled together - see shellCalc
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void calculateImpact(
+        shell *first, shell *last,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        calc->calculateImpact(first, last, Numerical, AddTraj, Hybrid,
+                              nThreads);
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void calculateImpactDistances(
+        shell &s, const std::vector<double> &distances,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        calc->calculateImpactDistances(s, distances, Numerical, AddTraj, Hybrid,
+                                       nThreads);
+    }
+
+    template <auto Numerical>
+    void calculateFit(shell &s, std::size_t nThreads =
+                                    std::thread::hardware_concurrency()) const {
+        calc->calculateFit(s, Numerical, nThreads);
+    }
+
+    // Impact, angle and dispersion columns in one pass - see shellCalc
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void calculateImpactAnglesDispersion(
+        shell &s, const double thickness, const double inclination,
+        const dispersion::verticalTypes verticalType,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        calc->calculateImpactAnglesDispersion(s, thickness, inclination,
+                                              verticalType, Numerical, AddTraj,
+                                              Hybrid, nThreads);
+    }
+
+    void calculateAngles(const double thickness, const double inclination,
+                         shell &s,
+                         const std::size_t nThreads =
+                             std::thread::hardware_concurrency()) const {
+        calc->calculateAngles(thickness, inclination, s, nThreads);
+    }
+
+    void calculateDispersion(
+        const dispersion::verticalTypes verticalType, shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        calc->calculateDispersion(verticalType, s, nThreads);
+    }
+
+    void calculatePostPen(const double thickness, const double inclination,
+                          shell &s, std::vector<double> &angles,
+                          const bool changeDirection = false,
+                          const bool fast = false,
+                          const std::size_t nThreads =
+                              std::thread::hardware_concurrency()) const {
+        calc->calculatePostPen(thickness, inclination, s, angles,
+                               changeDirection, fast, nThreads);
+    }
+};
+}  // namespace wows_shell
@@ -0,0 +1,370 @@
+#pragma once
+// Included by exactly one shellCalc_<instruction set>.cpp. Every file is
+// compiled with the baseline flags: the inline and template code shared
+// between them (shell, utility, the standard library) is included first so
+// every copy of it is baseline code, whichever one the linker keeps. Only
+// what follows - shellCalc in namespace WOWS_SHELL_ISA and the vector
+// classes in VCL_NAMESPACE, both private to the file - targets the
+// instruction set, which the file names in:
+//  WOWS_SHELL_INSTRSET  level, see shellCPP.hpp
+//  WOWS_SHELL_TARGET    GCC / Clang target features of the kernels
+// MSVC needs no switch - its intrinsics build for any instruction set.
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#error "shellCalc_<instruction set>.cpp must be compiled for the baseline"
+#endif
+
+// Everything shellCPP.hpp and VCL include apart from themselves
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#if WOWS_SHELL_INSTRSET >= 5
+#include <immintrin.h>
+#endif
+
+#include "../controlEnums.hpp"
+#include "../shell.hpp"
+#include "../utility.hpp"
+#include "shellCalcInterface.hpp"
+
+#if WOWS_SHELL_INSTRSET >= 5
+#define INSTRSET WOWS_SHELL_INSTRSET
+// #pragma doesn't expand macros, _Pragma of a stringized one does
+#define WOWS_SHELL_STRING(...) #__VA_ARGS__
+#define WOWS_SHELL_PRAGMA(...) _Pragma(WOWS_SHELL_STRING(__VA_ARGS__))
+#if defined(__clang__)
+WOWS_SHELL_PRAGMA(clang attribute push(
+    __attribute__((target(WOWS_SHELL_TARGET))), apply_to = function))
+#elif defined(__GNUC__)
+// Left switched on to the end of the file, so this must be its last
+// include: templates are instantiated there, and GCC 12 clobbers their
+// vector return values (vzeroupper) if the target was switched off.
+WOWS_SHELL_PRAGMA(GCC target(WOWS_SHELL_TARGET))
+#endif
+#endif
+
+#include "../shellCPP.hpp"
+
+namespace wows_shell {
+inline namespace WOWS_SHELL_ISA {
+class shellCalcISA final : public shellCalcInterface {
+   private:
+    shellCalc calc;
+
+    template <numerical Numerical>
+    void calculateImpact(shell &s, const bool addTraj, const bool hybrid,
+                         const std::size_t nThreads) const {
+        if (hybrid) {
+            calc.calculateImpact<Numerical, true>(s, addTraj, nThreads);
+        } else {
+            calc.calculateImpact<Numerical, false>(s, addTraj, nThreads);
+        }
+    }
+
+    template <numerical Numerical>
+    void calculateImpact(shell *first, shell *last, const bool addTraj,
+                         const bool hybrid, const std::size_t nThreads) const {
+        if (addTraj) {
+            if (hybrid) {
+                calc.calculateImpact<true, Numerical, true>(first, last,
+                                                            nThreads);
+            } else {
+                calc.calculateImpact<true, Numerical, false>(first, last,
+                                                             nThreads);
+            }
+        } else {
+            if (hybrid) {
+                calc.calculateImpact<false, Numerical, true>(first, last,
+                                                             nThreads);
+            } else {
+                calc.calculateImpact<false, Numerical, false>(first, last,
+                                                              nThreads);
+            }
+        }
+    }
+
+    template <numerical Numerical>
+    void calculateImpactDistances(shell &s,
+                                  const std::vector<double> &distances,
+                                  const bool addTraj, const bool hybrid,
+                                  const std::size_t nThreads) const {
+        if (addTraj) {
+            if (hybrid) {
+                calc.calculateImpactDistances<true, Numerical, true>(
+                    s, distances, nThreads);
+            } else {
+                calc.calculateImpactDistances<true, Numerical, false>(
+                    s, distances, nThreads);
+            }
+        } else {
+            if (hybrid) {
+                calc.calculateImpactDistances<false, Numerical, true>(
+                    s, distances, nThreads);
+            } else {
+                calc.calculateImpactDistances<false, Numerical, false>(
+                    s, distances, nThreads);
+            }
+        }
+    }
+
+    template <auto Numerical>
+    void calculateImpactAnglesDispersion(
+        shell &s, const double thickness, const double inclination,
+        const dispersion::verticalTypes verticalType, const bool addTraj,
+        const bool hybrid, const std::size_t nThreads) const {
+        if (addTraj) {
+            if (hybrid) {
+                calc.calculateImpactAnglesDispersion<true, Numerical, true>(
+                    s, thickness, inclination, verticalType, nThreads);
+            } else {
+                calc.calculateImpactAnglesDispersion<true, Numerical, false>(
+                    s, thickness, inclination, verticalType, nThreads);
+            }
+        } else {
+            if (hybrid) {
+                calc.calculateImpactAnglesDispersion<false, Numerical, true>(
+                    s, thickness, inclination, verticalType, nThreads);
+            } else {
+                calc.calculateImpactAnglesDispersion<false, Numerical, false>(
+                    s, thickness, inclination, verticalType, nThreads);
+            }
+        }
+    }
+
+   public:
+    explicit shellCalcISA(const std::size_t numThreads) : calc(numThreads) {}
+    shellCalcISA(std::shared_ptr<utility::threadPool> pool,
+                 const std::size_t threadBudget)
+        : calc(std::move(pool), threadBudget) {}
+
+    void set_max(const double max) override { calc.set_max(max); }
+    void set_min(const double min) override { calc.set_min(min); }
+    void set_precision(const double precision) override {
+        calc.set_precision(precision);
+    }
+    void set_x0(const double x0) override { calc.set_x0(x0); }
+    void set_y0(const double y0) override { calc.set_y0(y0); }
+    void set_dt_min(const double dt) override { calc.set_dt_min(dt); }
+    void set_tolerance(const double tolerance) override {
+        calc.set_tolerance(tolerance);
+    }
+    void set_exactImpact(const bool exactImpact) override {
+        calc.set_exactImpact(exactImpact);
+    }
+    void set_laneRefill(const bool laneRefill) override {
+        calc.set_laneRefill(laneRefill);
+    }
+    void set_solveTolerance(const double solveTolerance) override {
+        calc.set_solveTolerance(solveTolerance);
+    }
+    void set_hybridHeight(const double hybridHeight) override {
+        calc.set_hybridHeight(hybridHeight);
+    }
+    void set_hybridScale(const double hybridScale) override {
+        calc.set_hybridScale(hybridScale);
+    }
+    void set_recordMode(const recording recordMode) override {
+        calc.set_recordMode(recordMode);
+    }
+    void set_recordStride(const std::size_t recordStride) override {
+        calc.set_recordStride(recordStride);
+    }
+    void set_recordSpacing(const double recordSpacing) override {
+        calc.set_recordSpacing(recordSpacing);
+    }
+    void set_recordTolerance(const double recordTolerance) override {
+        calc.set_recordTolerance(recordTolerance);
+    }
+    void set_xf0(const double xf0) override { calc.set_xf0(xf0); }
+    void set_yf0(const double yf0) override { calc.set_yf0(yf0); }
+    void set_dtf(const double dtf) override { calc.set_dtf(dtf); }
+    void set_cacheSize(const std::size_t cacheSize) override {
+        calc.set_cacheSize(cacheSize);
+    }
+    void clearCache() override { calc.clearCache(); }
+    std::size_t get_cacheHits() const override { return calc.get_cacheHits(); }
+    std::size_t get_cacheMisses() const override {
+        return calc.get_cacheMisses();
+    }
+    void set_threadBudget(const std::size_t threadBudget) override {
+        calc.set_threadBudget(threadBudget);
+    }
+    void set_minTasksPerThread(const std::size_t minTasksPerThread) override {
+        calc.set_minTasksPerThread(minTasksPerThread);
+    }
+    std::shared_ptr<utility::threadPool> get_threadPool() const override {
+        return calc.get_threadPool();
+    }
+
+    std::size_t calculateAlignmentSize(
+        std::size_t unalignedSize) const noexcept override {
+        return calc.calculateAlignmentSize(unalignedSize);
+    }
+
+    void calculateImpact(shell &s, const numerical Numerical,
+                         const bool addTraj, const bool hybrid,
+                         const std::size_t nThreads) const override {
+        switch (Numerical) {
+            case numerical::forwardEuler:
+                return calculateImpact<numerical::forwardEuler>(
+                    s, addTraj, hybrid, nThreads);
+            case numerical::rungeKutta2:
+                return calculateImpact<numerical::rungeKutta2>(
+                    s, addTraj, hybrid, nThreads);
+            case numerical::rungeKutta4:
+                return calculateImpact<numerical::rungeKutta4>(
+                    s, addTraj, hybrid, nThreads);
+            case numerical::adamsBashforth5:
+                return calculateImpact<numerical::adamsBashforth5>(
+                    s, addTraj, hybrid, nThreads);
+            case numerical::dormandPrince45:
+                return calculateImpact<numerical::dormandPrince45>(
+                    s, addTraj, hybrid, nThreads);
+        }
+    }
+
+    void calculateImpact(shell *first, shell *last, const numerical Numerical,
+                         const bool addTraj, const bool hybrid,
+                         const std::size_t nThreads) const override {
+        switch (Numerical) {
+            case numerical::forwardEuler:
+                return calculateImpact<numerical::forwardEuler>(
+                    first, last, addTraj, hybrid, nThreads);
+            case numerical::rungeKutta2:
+                return calculateImpact<numerical::rungeKutta2>(
+                    first, last, addTraj, hybrid, nThreads);
+            case numerical::rungeKutta4:
+                return calculateImpact<numerical::rungeKutta4>(
+                    first, last, addTraj, hybrid, nThreads);
+            case numerical::adamsBashforth5:
+                return calculateImpact<numerical::adamsBashforth5>(
+                    first, last, addTraj, hybrid, nThreads);
+            case numerical::dormandPrince45:
+                return calculateImpact<numerical::dormandPrince45>(
+                    first, last, addTraj, hybrid, nThreads);
+        }
+    }
+
+    void calculateImpactDistances(shell &s,
+                                  const std::vector<double> &distances,
+                                  const numerical Numerical, const bool addTraj,
+                                  const bool hybrid,
+                                  const std::size_t nThreads) const override {
+        switch (Numerical) {
+            case numerical::forwardEuler:
+                return calculateImpactDistances<numerical::forwardEuler>(
+                    s, distances, addTraj, hybrid, nThreads);
+            case numerical::rungeKutta2:
+                return calculateImpactDistances<numerical::rungeKutta2>(
+                    s, distances, addTraj, hybrid, nThreads);
+            case numerical::rungeKutta4:
+                return calculateImpactDistances<numerical::rungeKutta4>(
+                    s, distances, addTraj, hybrid, nThreads);
+            case numerical::adamsBashforth5:
+                return calculateImpactDistances<numerical::adamsBashforth5>(
+                    s, distances, addTraj, hybrid, nThreads);
+            case numerical::dormandPrince45:
+                return calculateImpactDistances<numerical::dormandPrince45>(
+                    s, distances, addTraj, hybrid, nThreads);
+        }
+    }
+
+    void calculateFit(shell &s, const numerical Numerical,
+                      const std::size_t nThreads) const override {
+        switch (Numerical) {
+            case numerical::forwardEuler:
+                return calc.calculateFit<numerical::forwardEuler>(s, nThreads);
+            case numerical::rungeKutta2:
+                return calc.calculateFit<numerical::rungeKutta2>(s, nThreads);
+            case numerical::rungeKutta4:
+                return calc.calculateFit<numerical::rungeKutta4>(s, nThreads);
+            case numerical::adamsBashforth5:
+                return calc.calculateFit<numerical::adamsBashforth5>(s,
+                                                                    nThreads);
+            case numerical::dormandPrince45:
+                return calc.calculateFit<numerical::dormandPrince45>(s,
+                                                                    nThreads);
+        }
+    }
+
+    void calculateImpactAnglesDispersion(
+        shell &s, const double thickness, const double inclination,
+        const dispersion::verticalTypes verticalType, const numerical Numerical,
+        const bool addTraj, const bool hybrid,
+        const std::size_t nThreads) const override {
+        switch (Numerical) {
+            case numerical::forwardEuler:
+                return calculateImpactAnglesDispersion<numerical::forwardEuler>(
+                    s, thickness, inclination, verticalType, addTraj, hybrid,
+                    nThreads);
+            case numerical::rungeKutta2:
+                return calculateImpactAnglesDispersion<numerical::rungeKutta2>(
+                    s, thickness, inclination, verticalType, addTraj, hybrid,
+                    nThreads);
+            case numerical::rungeKutta4:
+                return calculateImpactAnglesDispersion<numerical::rungeKutta4>(
+                    s, thickness, inclination, verticalType, addTraj, hybrid,
+                    nThreads);
+            case numerical::adamsBashforth5:
+                return calculateImpactAnglesDispersion<
+                    numerical::adamsBashforth5>(s, thickness, inclination,
+                                   verticalType, addTraj, hybrid, nThreads);
+            case numerical::dormandPrince45:
+                return calculateImpactAnglesDispersion<
+                    numerical::dormandPrince45>(s, thickness, inclination,
+                                   verticalType, addTraj, hybrid, nThreads);
+        }
+    }
+
+    void calculateAngles(const double thickness, const double inclination,
+                         shell &s, const std::size_t nThreads) const override {
+        calc.calculateAngles(thickness, inclination, s, nThreads);
+    }
+
+    void calculateDispersion(const dispersion::verticalTypes verticalType,
+                             shell &s,
+                             const std::size_t nThreads) const override {
+        calc.calculateDispersion(verticalType, s, nThreads);
+    }
+
+    void calculatePostPen(const double thickness, const double inclination,
+                          shell &s, std::vector<double> &angles,
+                          const bool changeDirection, const bool fast,
+                          const std::size_t nThreads) const override {
+        calc.calculatePostPen(thickness, inclination, s, angles,
+                              changeDirection, fast, nThreads);
+    }
+};
+
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    const std::size_t numThreads) {
+    return std::make_unique<shellCalcISA>(numThreads);
+}
+
+std::unique_ptr<shellCalcInterface> makeShellCalc(
+    std::shared_ptr<utility::threadPool> pool, const std::size_t threadBudget) {
+    return std::make_unique<shellCalcISA>(std::move(pool), threadBudget);
+}
+}  // namespace WOWS_SHELL_ISA
+}  // namespace wows_shell
+
+#if WOWS_SHELL_INSTRSET >= 5 && defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "../controlEnums.hpp"
+#include "../shell.hpp"
+
+namespace wows_shell {
+// Runtime counterpart of shellCalc - template parameters become arguments so
+// that builds for different instruction sets can sit behind one pointer
+class shellCalcInterface {
+   public:
+    virtual ~shellCalcInterface() = default;
+
+    virtual void set_max(const double max) = 0;
+    virtual void set_min(const double min) = 0;
+    virtual void set_precision(const double precision) = 0;
+    virtual void set_x0(const double x0) = 0;
+    virtual void set_y0(const double y0) = 0;
+    virtual void set_dt_min(const double dt) = 0;
+    virtual void set_tolerance(const double tolerance) = 0;
+    virtual void set_exactImpact(const bool exactImpact) = 0;
+    virtual void set_laneRefill(const bool laneRefill) = 0;
+    virtual void set_solveTolerance(const double solveTolerance) = 0;
+    virtual void set_hybridHeight(const double hybridHeight) = 0;
+    virtual void set_hybridScale(const double hybridScale) = 0;
+    virtual void set_recordMode(const recording recordMode) = 0;
+    virtual void set_recordStride(const std::size_t recordStride) = 0;
+    virtual void set_recordSpacing(const double recordSpacing) = 0;
+    virtual void set_recordTolerance(const double recordTolerance) = 0;
+    virtual void set_xf0(const double xf0) = 0;
+    virtual void set_yf0(const double yf0) = 0;
+    virtual void set_dtf(const double dtf) = 0;
+    virtual void set_cacheSize(const std::size_t cacheSize) = 0;
+    virtual void clearCache() = 0;
+    virtual std::size_t get_cacheHits() const = 0;
+    virtual std::size_t get_cacheMisses() const = 0;
+    virtual void set_threadBudget(const std::size_t threadBudget) = 0;
+    virtual void set_minTasksPerThread(const std::size_t minTasksPerThread) = 0;
+    virtual std::shared_ptr<utility::threadPool> get_threadPool() const = 0;
+
+    virtual std::size_t calculateAlignmentSize(
+        std::size_t unalignedSize) const noexcept = 0;
+    virtual void calculateImpact(shell &s, const numerical Numerical,
+                                 const bool addTraj, const bool hybrid,
+                                 const std::size_t nThreads) const = 0;
+    // Shells [first, last) scheduled together
+    virtual void calculateImpact(shell *first, shell *last,
+                                 const numerical Numerical,
+                                 const bool addTraj, const bool hybrid,
+                                 const std::size_t nThreads) const = 0;
+    virtual void calculateImpactDistances(
+        shell &s, const std::vector<double> &distances,
+        const numerical Numerical, const bool addTraj, const bool hybrid,
+        const std::size_t nThreads) const = 0;
+    virtual void calculateFit(shell &s, const numerical Numerical,
+                              const std::size_t nThreads) const = 0;
+    // Impact, angle and dispersion columns in one pass
+    virtual void calculateImpactAnglesDispersion(
+        shell &s, const double thickness, const double inclination,
+        const dispersion::verticalTypes verticalType, const numerical Numerical,
+        const bool addTraj, const bool hybrid,
+        const std::size_t nThreads) const = 0;
+    virtual void calculateAngles(const double thickness,
+                                 const double inclination, shell &s,
+                                 const std::size_t nThreads) const = 0;
+    virtual void calculateDispersion(
+        const dispersion::verticalTypes verticalType, shell &s,
+        const std::size_t nThreads) const = 0;
+    virtual void calculatePostPen(const double thickness,
+                                  const double inclination, shell &s,
+                                  std::vector<double> &angles,
+                                  const bool changeDirection, const bool fast,
+                                  const std::size_t nThreads) const = 0;
+};
+}  // namespace wows_shell
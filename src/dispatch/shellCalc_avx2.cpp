@@ -0,0 +1,7 @@
+// AVX2 build of shellCalc - compile without instruction set flags like
+// the others, see shellCalcISA.hpp
+#define WOWS_SHELL_ISA avx2
+#define WOWS_SHELL_INSTRSET 8
+#define WOWS_SHELL_TARGET "avx2,fma"
+#define VCL_NAMESPACE vcl_avx2
+#include "shellCalcISA.hpp"
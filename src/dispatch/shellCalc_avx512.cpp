@@ -0,0 +1,7 @@
+// AVX-512 build of shellCalc - compile without instruction set flags like
+// the others, see shellCalcISA.hpp
+#define WOWS_SHELL_ISA avx512
+#define WOWS_SHELL_INSTRSET 9
+#define WOWS_SHELL_TARGET "avx512f,avx2,fma"
+#define VCL_NAMESPACE vcl_avx512
+#include "shellCalcISA.hpp"
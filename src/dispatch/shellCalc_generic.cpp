@@ -0,0 +1,4 @@
+// Baseline build of shellCalc - compile without any instruction set flags
+#define WOWS_SHELL_ISA generic
+#define WOWS_SHELL_INSTRSET 0
+#include "shellCalcISA.hpp"
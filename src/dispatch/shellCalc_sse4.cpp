@@ -0,0 +1,7 @@
+// SSE4.2 build of shellCalc - compile without instruction set flags like
+// the others, see shellCalcISA.hpp
+#define WOWS_SHELL_ISA sse4
+#define WOWS_SHELL_INSTRSET 6
+#define WOWS_SHELL_TARGET "sse4.2,popcnt"
+#define VCL_NAMESPACE vcl_sse4
+#include "shellCalcISA.hpp"
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -98,16 +99,118 @@ struct dispersionParams {
     }
 };
 
-double combinedAirDrag(double cD, double caliber, double mass) {
+inline double combinedAirDrag(double cD, double caliber, double mass) {
     return 0.5 * cD * pow((caliber / 2), 2) * M_PI / mass;
 }
 
-double combinedPenetration(double krupp, double mass, double caliber) {
+inline double combinedPenetration(double krupp, double mass,
+                                  double caliber) {
     return 0.00046905491615181766 * krupp / 2400 * pow(mass, 0.5506) *
            pow(caliber, -0.6521);
 }
 
-class shell {
+// Recorded trajectories end to end in one buffer. Trajectory i owns a slot
+// of capacity points - its x values followed by its y values - sized from
+// an estimate before the calculation. Points past the capacity spill over
+// until compact() moves every trajectory into an exactly sized slot.
+// Different trajectories may be recorded from different threads.
+template <typename Real>
+class trajectoryArena {
+   public:
+    struct view {
+        const Real *x, *y;
+        std::size_t size;
+    };
+
+   private:
+    std::vector<Real> data;
+    std::vector<std::size_t> offsets, capacities, lengths;
+    std::vector<std::vector<Real>> spill;  // x, y pairs past the capacity
+
+   public:
+    // n trajectories - capacity(i) points reserved for trajectory i
+    template <typename Capacity>
+    void reset(const std::size_t n, Capacity capacity) {
+        offsets.resize(n);
+        capacities.resize(n);
+        lengths.assign(n, 0);
+        spill.resize(n);
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            offsets[i] = total;
+            capacities[i] = capacity(i);
+            total += 2 * capacities[i];
+            spill[i].clear();
+        }
+        data.resize(total);
+    }
+
+    std::size_t size() const { return offsets.size(); }
+
+    void clear(const std::size_t i) {
+        lengths[i] = 0;
+        spill[i].clear();
+    }
+
+    void push_back(const std::size_t i, const Real x, const Real y) {
+        const std::size_t j = lengths[i]++;
+        if (j < capacities[i]) {
+            data[offsets[i] + j] = x;
+            data[offsets[i] + capacities[i] + j] = y;
+        } else {
+            spill[i].push_back(x);
+            spill[i].push_back(y);
+        }
+    }
+
+    // Replaces the latest point of trajectory i
+    void set_back(const std::size_t i, const Real x, const Real y) {
+        const std::size_t j = lengths[i] - 1;
+        if (j < capacities[i]) {
+            data[offsets[i] + j] = x;
+            data[offsets[i] + capacities[i] + j] = y;
+        } else {
+            spill[i][2 * (j - capacities[i])] = x;
+            spill[i][2 * (j - capacities[i]) + 1] = y;
+        }
+    }
+
+    // Moves spilled points into place - only repacks if anything spilled
+    void compact() {
+        if (std::all_of(spill.begin(), spill.end(),
+                        [](const auto &points) { return points.empty(); }))
+            return;
+        std::size_t total = 0;
+        for (const std::size_t length : lengths) total += 2 * length;
+        std::vector<Real> packed(total);
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < size(); ++i) {
+            const std::size_t kept = std::min(lengths[i], capacities[i]);
+            Real *x = &packed[offset], *y = x + lengths[i];
+            std::copy_n(&data[offsets[i]], kept, x);
+            std::copy_n(&data[offsets[i] + capacities[i]], kept, y);
+            for (std::size_t j = kept; j < lengths[i]; ++j) {
+                x[j] = spill[i][2 * (j - kept)];
+                y[j] = spill[i][2 * (j - kept) + 1];
+            }
+            spill[i] = {};
+            offsets[i] = offset;
+            capacities[i] = lengths[i];
+            offset += 2 * lengths[i];
+        }
+        data.swap(packed);
+    }
+
+    // Valid once compacted - shellCalc compacts after recording
+    view operator[](const std::size_t i) const {
+        const Real *x = data.data() + offsets[i];
+        return {x, x + capacities[i], lengths[i]};
+    }
+};
+
+// Real: type of the computed data - the shell parameters stay double
+template <typename Real>
+class basic_shell {
    public:  // Description                units
     // Shell
     double v0;             // muzzle velocity            m/s
@@ -160,6 +263,7 @@ class shell {
     // Condenses initial values into values used by calculations
     //[Reduces repeated computations]
     void preProcess() {
+        markChanged();
         k = combinedAirDrag(cD, caliber, mass);  // condensed drag coefficient
         cw_2 = 0;                                // linear drag coefficient
         pPPC = combinedPenetration(krupp, mass, caliber);
@@ -190,20 +294,52 @@ class shell {
         halfRatio = utility::invCDF(.25 * Z + utility::cdf(left)) / left;
     }
 
+    // Flags the parameter groups that differ from the last preProcess
+    void markChanged() {
+        using parameters::group, parameters::groups;
+        const std::array<double, 7> current = {v0,    caliber,       mass, cD,
+                                               krupp, normalization, nonAP};
+        if (processedParameters) {
+            const auto &processed = *processedParameters;
+            if (!std::equal(current.begin(), current.begin() + 4,
+                            processed.begin()))
+                changedParameters |= group(groups::trajectory);
+            if (!std::equal(current.begin() + 4, current.end(),
+                            processed.begin() + 4))
+                changedParameters |= group(groups::penetration);
+        } else {
+            changedParameters = parameters::allGroups;
+        }
+        processedParameters = current;
+    }
+
     // Not 100% necessary - sizes adjusted to fulfill alignment
     bool completedImpact = false, completedAngles = false,
          completedDispersion = false, completedPostPen = false;
-
-    /*trajectories output
-    [0           ]trajx 0        [1           ]trajy 1
-    ...
-    [size * 2 - 2]trajx size - 1 [size * 2 - 1]trajy size - 1
-    */
-    std::vector<std::vector<double>> trajectories;
+    // Cache key of the calculation that produced impactData - empty when it
+    // can't be reproduced from the shell and calculator settings alone
+    std::string impactSignature;
+    // Integration settings impactData was computed with - angles,
+    // dispersion and post-penetration recompute it with the same ones when
+    // it is out of date
+    numerical impactNumerical = numerical::forwardEuler;
+    bool impactHybrid = false, impactAddTraj = false;
+    // Parameter groups changed since impactData was computed - shellCalc
+    // redoes only what they affect. Direct writes to the parameters are
+    // picked up by preProcess.
+    parameters::groupMask changedParameters = parameters::allGroups;
+    // v0, caliber, mass, cD, krupp, normalization, nonAP as of the last
+    // preProcess
+    std::optional<std::array<double, 7>> processedParameters;
+
+    // Trajectory of each impact row - trajectories[row].x / .y
+    trajectoryArena<Real> trajectories;
 
     // Refer to stdDataIndex enums defined above
     std::size_t impactSize = 0, impactSizeAligned;
-    std::vector<double> impactData;
+    std::vector<Real> impactData;
+    // Columns of impactData that were computed
+    impact::columnMask impactMask = 0;
 
     /* Angles data
      * [0:1)-ra0 max lateral angle
@@ -213,7 +349,7 @@ class shell {
      * [4:5)-penetration max lateral angle
      * [5:6)-penetration max lateral angle
      */
-    std::vector<double> angleData;
+    std::vector<Real> angleData;
 
     /* Dispersion data
      *  [0:1)- max horizontal
@@ -226,18 +362,18 @@ class shell {
      *  [7:8)- std area
      *  [8:9)- 50% area
      */
-    std::vector<double> dispersionData;
+    std::vector<Real> dispersionData;
 
     /* WARNING: LOCATION OF LATERAL ANGLE IN VECTOR CANNOT BE CHANGED OR ELSE
      * SIMD ALIGNMENT MAY NOT BE GUARANTEED [0:1) Lateral Angle [1:2) Distance
      * [2:3) X [3:4) Y [4:5) Z             [5:6) XWF See enums defined above
      */
     std::size_t postPenSize = 0, postPenSizeAligned;
-    std::vector<double> postPenData;
+    std::vector<Real> postPenData;
 
-    shell() = default;
+    basic_shell() = default;
 
-    shell(const double caliber, const double v0, const double cD,
+    basic_shell(const double caliber, const double v0, const double cD,
           const double mass, const double krupp, const double normalization,
           const double fuseTime, const double threshold, const double ricochet0,
           const double ricochet1, const double nonAP, const std::string &name) {
@@ -245,11 +381,11 @@ class shell {
                   threshold, ricochet0, ricochet1, nonAP, name);
     }  // TODO: Deprecate / Remove because this is very unclean
 
-    shell(const shellParams &sp, const std::string &name) {
+    basic_shell(const shellParams &sp, const std::string &name) {
         setValues(sp, name);
     }
 
-    shell(const shellParams &sp, const dispersionParams &dp,
+    basic_shell(const shellParams &sp, const dispersionParams &dp,
           const std::string &name) {
         setValues(sp, dp, name);
     }
@@ -343,90 +479,90 @@ class shell {
     }
 
     // Getter Functions
-    double &get_impact(const std::size_t row, impact::impactIndices impact) {
+    Real &get_impact(const std::size_t row, impact::impactIndices impact) {
         return get_impact(row, toUnderlying(impact));
     }
-    double &get_impact(const std::size_t row, const std::size_t impact) {
+    Real &get_impact(const std::size_t row, const std::size_t impact) {
         return impactData[row + impact * impactSizeAligned];
     }
 
-    double *get_impactPtr(const std::size_t row, impact::impactIndices impact) {
+    Real *get_impactPtr(const std::size_t row, impact::impactIndices impact) {
         return get_impactPtr(row, toUnderlying(impact));
     }
-    double *get_impactPtr(const std::size_t row, const std::size_t impact) {
+    Real *get_impactPtr(const std::size_t row, const std::size_t impact) {
         return impactData.data() + row + impact * impactSizeAligned;
     }
 
-    double &get_angle(const std::size_t row, angle::angleIndices data) {
+    Real &get_angle(const std::size_t row, angle::angleIndices data) {
         return get_angle(row, toUnderlying(data));
     }
-    double &get_angle(const std::size_t row, const std::size_t impact) {
+    Real &get_angle(const std::size_t row, const std::size_t impact) {
         return angleData[row + impact * impactSizeAligned];
     }
 
-    double *get_anglePtr(const std::size_t row, angle::angleIndices data) {
+    Real *get_anglePtr(const std::size_t row, angle::angleIndices data) {
         return get_anglePtr(row, toUnderlying(data));
     }
-    double *get_anglePtr(const std::size_t row, const std::size_t impact) {
+    Real *get_anglePtr(const std::size_t row, const std::size_t impact) {
         return angleData.data() + row + impact * impactSizeAligned;
     }
 
-    double *get_dispersionPtr(const std::size_t row, const std::size_t impact) {
+    Real *get_dispersionPtr(const std::size_t row, const std::size_t impact) {
         return dispersionData.data() + row + impact * impactSizeAligned;
     }
 
-    double *get_dispersionPtr(const std::size_t row,
-                              dispersion::dispersionIndices data) {
+    Real *get_dispersionPtr(const std::size_t row,
+                            dispersion::dispersionIndices data) {
         return get_dispersionPtr(row, toUnderlying(data));
     }
 
-    double &get_dispersion(const std::size_t row, const std::size_t impact) {
+    Real &get_dispersion(const std::size_t row, const std::size_t impact) {
         return *get_dispersionPtr(row, impact);
     }
 
-    double &get_dispersion(const std::size_t row,
-                           dispersion::dispersionIndices data) {
+    Real &get_dispersion(const std::size_t row,
+                         dispersion::dispersionIndices data) {
         return *get_dispersionPtr(row, data);
     }
 
-    double &get_postPen(const std::size_t row, post::postPenIndices data,
-                        const std::size_t angle) {
+    Real &get_postPen(const std::size_t row, post::postPenIndices data,
+                      const std::size_t angle) {
         return get_postPen(row, toUnderlying(data), angle);
     }
-    double &get_postPen(const std::size_t row, const std::size_t data,
-                        const std::size_t angle) {
+    Real &get_postPen(const std::size_t row, const std::size_t data,
+                      const std::size_t angle) {
         return postPenData[row + data * postPenSize + angle * impactSize];
     }
 
-    double *get_postPenPtr(const std::size_t row, post::postPenIndices data,
-                           const std::size_t angle) {
+    Real *get_postPenPtr(const std::size_t row, post::postPenIndices data,
+                         const std::size_t angle) {
         return get_postPenPtr(row, toUnderlying(data), angle);
     }
-    double *get_postPenPtr(const std::size_t row, const std::size_t angle,
-                           const std::size_t impact) {
+    Real *get_postPenPtr(const std::size_t row, const std::size_t angle,
+                         const std::size_t impact) {
         return postPenData.data() + row + angle * postPenSize +
                impact * impactSize;
     }
 
-    std::tuple<std::size_t, double> maxDist() {
+    std::tuple<std::size_t, Real> maxDist() {
         std::size_t errorCode = std::numeric_limits<std::size_t>::max();
         if (impactSize == 0) return {errorCode, 0};
-        std::tuple<std::size_t, double> t = {0, 0};
+        std::tuple<std::size_t, Real> t = {0, 0};
         for (std::size_t i = 1; i < impactSize; i++) {
-            double distance = get_impact(i, impact::impactIndices::distance);
+            Real distance = get_impact(i, impact::impactIndices::distance);
             t = std::get<1>(t) < distance ? std::make_tuple(i, distance) : t;
         }
         return t;
     }
 
-    double interpolateDistanceImpact(double distance,
-                                     impact::impactIndices data) {
+    Real interpolateDistanceImpact(Real distance,
+                                   impact::impactIndices data) {
         return interpolateDistanceImpact(distance, toUnderlying(data));
     }
-    double interpolateDistanceImpact(double distance, uint32_t impact) {
+    Real interpolateDistanceImpact(Real distance, uint32_t impact) {
         std::size_t maxIndex = std::get<0>(maxDist()),
                     maxErrorCode = std::numeric_limits<std::size_t>::max();
-        double errorCode = std::numeric_limits<double>::max();
+        Real errorCode = std::numeric_limits<Real>::max();
         if (maxIndex == maxErrorCode) return errorCode;
         if (distance < get_impact(0, impact::impactIndices::distance))
             return errorCode;
@@ -437,28 +573,95 @@ class shell {
         auto iter_max = std::lower_bound(
             get_impactPtr(0, impact::impactIndices::distance),
             get_impactPtr(maxIndex, impact::impactIndices::distance), distance);
-        double upperDistance = *iter_max;
+        Real upperDistance = *iter_max;
         uint32_t upperIndex =
             iter_max - get_impactPtr(0, impact::impactIndices::distance);
-        double upperTarget = get_impact(upperIndex, impact);
+        Real upperTarget = get_impact(upperIndex, impact);
 
         if (upperIndex == 0) return upperIndex;
         // Only activates if distance = min and prevents segfault
 
         auto iter_min = iter_max - 1;
-        double lowerDistance = *iter_min;
+        Real lowerDistance = *iter_min;
         uint32_t lowerIndex =
             iter_min - get_impactPtr(0, impact::impactIndices::distance);
-        double lowerTarget = get_impact(lowerIndex, impact);
+        Real lowerTarget = get_impact(lowerIndex, impact);
 
         /*std::cout << minIndex << " " << minDistance << " " << minTarget << " "
                   << maxIndex << " " << maxDistance << " " << maxTarget << "\n";
                   */
-        double slope =
+        Real slope =
             ((upperTarget - lowerTarget) / (upperDistance - lowerDistance));
         return slope * (distance - lowerDistance) + lowerTarget;
     }
 
+    // interpolateDistanceImpact of every distance for every column -
+    // out[i * nColumns + j] for distances[i] and columns[j]. The range is
+    // found once and the distances are swept in increasing order instead of
+    // searched one by one. NaN distances are out of range.
+    void interpolateDistanceImpact(const Real *distances,
+                                   const std::size_t nDistances,
+                                   const uint32_t *columns,
+                                   const std::size_t nColumns, Real *out) {
+        constexpr std::size_t maxErrorCode =
+            std::numeric_limits<std::size_t>::max();
+        const std::size_t maxIndex = std::get<0>(maxDist());
+        const Real errorCode = std::numeric_limits<Real>::max();
+        std::vector<std::size_t> order;
+        order.reserve(nDistances);
+        for (std::size_t i = 0; i < nDistances; ++i) {
+            const Real distance = distances[i];
+            if (maxIndex != maxErrorCode &&
+                distance >= get_impact(0, impact::impactIndices::distance) &&
+                distance <=
+                    get_impact(maxIndex, impact::impactIndices::distance)) {
+                order.push_back(i);
+            } else {
+                std::fill_n(out + i * nColumns, nColumns, errorCode);
+            }
+        }
+        std::sort(order.begin(), order.end(),
+                  [&](const std::size_t a, const std::size_t b) {
+                      return distances[a] < distances[b];
+                  });
+
+        const Real *impactDistances =
+            get_impactPtr(0, impact::impactIndices::distance);
+        std::size_t upperIndex = 0;
+        for (const std::size_t i : order) {
+            const Real distance = distances[i];
+            // Same row as the lower_bound of the single lookup
+            while (upperIndex < maxIndex &&
+                   impactDistances[upperIndex] < distance) {
+                ++upperIndex;
+            }
+            Real *row = out + i * nColumns;
+            if (upperIndex == 0) {
+                std::fill_n(row, nColumns, 0);
+                continue;
+            }
+            const std::size_t lowerIndex = upperIndex - 1;
+            const Real upperDistance = impactDistances[upperIndex],
+                       lowerDistance = impactDistances[lowerIndex];
+            for (std::size_t j = 0; j < nColumns; ++j) {
+                const Real upperTarget = get_impact(upperIndex, columns[j]),
+                           lowerTarget = get_impact(lowerIndex, columns[j]);
+                const Real slope = ((upperTarget - lowerTarget) /
+                                    (upperDistance - lowerDistance));
+                row[j] = slope * (distance - lowerDistance) + lowerTarget;
+            }
+        }
+    }
+
+    std::vector<Real> interpolateDistanceImpact(
+        const std::vector<Real> &distances,
+        const std::vector<uint32_t> &columns) {
+        std::vector<Real> out(distances.size() * columns.size());
+        interpolateDistanceImpact(distances.data(), distances.size(),
+                                  columns.data(), columns.size(), out.data());
+        return out;
+    }
+
     // internal computed data - fixed
     const double &get_v0() { return v0; }
     const double &get_k() { return k; }
@@ -524,15 +727,18 @@ class shell {
                       << std::endl;
         } else {
             std::cout << "Index:[" << target << "] X Y\n";
-            for (std::vector<double>::size_type i = 0;
-                 i < trajectories[target * 2].size(); i++) {
-                std::cout << trajectories[target * 2][i] << " "
-                          << trajectories[target * 2 + 1][i] << std::endl;
+            const auto trajectory = trajectories[target];
+            for (std::size_t i = 0; i < trajectory.size; i++) {
+                std::cout << trajectory.x[i] << " " << trajectory.y[i]
+                          << std::endl;
             }
         }
     }
 };
 
+using shell = basic_shell<double>;
+using shellFloat = basic_shell<float>;
+
 template <typename T>
 std::string generateHash(const T k, const T p, const T v0,
                          const T normalization, const T fuseTime,
@@ -548,18 +754,19 @@ std::string generateHash(const T k, const T p, const T v0,
     return utility::base85Encode(hashString);
 }
 
-std::string generateHash(const double caliber, const double v0, const double cD,
-                         const double mass, const double krupp,
-                         const double normalization, const double fuseTime,
-                         const double threshold, const double ricochet0,
-                         const double ricochet1, const double nonAP) {
+inline std::string generateHash(const double caliber, const double v0,
+                                const double cD, const double mass,
+                                const double krupp, const double normalization,
+                                const double fuseTime, const double threshold,
+                                const double ricochet0, const double ricochet1,
+                                const double nonAP) {
     double k = combinedAirDrag(cD, caliber, mass);
     double p = combinedPenetration(krupp, mass, caliber);
     return generateHash(k, p, v0, normalization, threshold, fuseTime, ricochet0,
                         ricochet1, nonAP);
 }
 
-std::string generateShellParamHash(
+inline std::string generateShellParamHash(
     const double caliber, const double v0, const double cD, const double mass,
     const double krupp, const double normalization, const double fuseTime,
     const double threshold, const double ricochet0, const double ricochet1,
@@ -568,12 +775,16 @@ std::string generateShellParamHash(
                         threshold, ricochet0, ricochet1, nonAP);
 }
 
-std::string generateHash(const shell &s) {
+template <typename Real>
+std::string generateHash(const basic_shell<Real> &s) {
     return generateHash(s.caliber, s.v0, s.cD, s.mass, s.krupp, s.normalization,
                         s.fuseTime, s.threshold, s.ricochet0, s.ricochet1,
                         s.nonAP);
 }
 
-std::string generateShellHash(const shell &s) { return generateHash(s); }
+template <typename Real>
+std::string generateShellHash(const basic_shell<Real> &s) {
+    return generateHash(s);
+}
 
 }  // namespace wows_shell
\ No newline at end of file
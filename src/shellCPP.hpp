@@ -10,23 +10,79 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "controlEnums.hpp"
 #include "shell.hpp"
 #include "utility.hpp"
 
-#if defined(__SSE4_1__) || defined(__AVX__)
+// Instruction set the kernels are vectorized for, numbered like VCL's
+// INSTRSET (5: SSE4.1, 6: SSE4.2, 8: AVX2, 9: AVX-512F). Taken from the
+// compiler flags unless dispatch/shellCalcISA.hpp targets only the kernels.
+#ifndef WOWS_SHELL_INSTRSET
+#if defined(__AVX512F__)
+#define WOWS_SHELL_INSTRSET 9
+#elif defined(__AVX2__)
+#define WOWS_SHELL_INSTRSET 8
+#elif defined(__AVX__)
+#define WOWS_SHELL_INSTRSET 7
+#elif defined(__SSE4_2__)
+#define WOWS_SHELL_INSTRSET 6
+#elif defined(__SSE4_1__)
+#define WOWS_SHELL_INSTRSET 5
+#else
+#define WOWS_SHELL_INSTRSET 0
+#endif
+#endif
+
+#if WOWS_SHELL_INSTRSET >= 5
 #include "version2/vectorclass.h"
 #include "version2/vectormath_exp.h"
 #include "version2/vectormath_trig.h"
 #endif
 
+// shellCalc is compiled into a namespace named after the instruction set so
+// that builds for several instruction sets can be linked into one binary -
+// see dispatch/shellCalcDispatch.hpp
+#ifndef WOWS_SHELL_ISA
+#if WOWS_SHELL_INSTRSET >= 9
+#define WOWS_SHELL_ISA avx512
+#elif WOWS_SHELL_INSTRSET >= 8
+#define WOWS_SHELL_ISA avx2
+#elif WOWS_SHELL_INSTRSET >= 5
+#define WOWS_SHELL_ISA sse4
+#else
+#define WOWS_SHELL_ISA generic
+#endif
+#endif
+
 namespace wows_shell {
-class shellCalc {
+inline namespace WOWS_SHELL_ISA {
+#if WOWS_SHELL_INSTRSET >= 5 && defined(VCL_NAMESPACE)
+using namespace VCL_NAMESPACE;
+#endif
+// Default visitor of calculateImpact - integration steps aren't visited
+struct noVisitor {};
+// Default work done on each vector group after its impact columns - none
+struct noEpilogue {
+    template <typename... Args>
+    void operator()(Args &&...) const noexcept {}
+};
+
+// Real: float or double - the type trajectories are integrated in and results
+// are stored as. float doubles the lanes per vector at ~5 significant digits.
+// Atmosphere: how air density is evaluated - see atmosphere
+template <typename Real, atmosphere Atmosphere = atmosphere::polynomial>
+class basic_shellCalc {
+   public:
+    using shell = basic_shell<Real>;
+
    private:
     // TODO: Static Constexpr these
     // Physical Constants     Description                  | Units
@@ -41,12 +97,29 @@ class shellCalc {
     static constexpr double cw_1 = 1;
 
     static constexpr double gMRL = (g * M) / (R * L);
+    // Air density polynomial - atmosphere::polynomial
+    static constexpr double densityFitHeight =
+        15000;  // Top of the fitted range      | m
+    static constexpr std::size_t densityDegree = 8;
+    // Coefficients in x = 2 * y / densityFitHeight - 1, highest degree first
+    std::array<double, densityDegree + 1> densityCoeffs{};
+
     // Calculation Parameters
     double maxA = 25;       // Max Angle                    | degrees
     double minA = 0;        // Min Angle                    | degrees
     double precision = .1;  // Angle Step                   | degrees
     double x0 = 0, y0 = 0;  // Starting x0, y0              | m
     double dt_min = .02;    // Time step                    | s
+    double tolerance = 1e-6;  // Adaptive step error bound  | [ndim]
+    bool exactImpact = false;  // Interpolate to y = 0        | [bool]
+    bool laneRefill = false;   // Refill lanes that landed    | [bool]
+    double solveTolerance = .01;  // Solved distance error      | m
+    double hybridHeight = 500;  // Hybrid: fine steps below   | m
+    double hybridScale = 4;     // Hybrid: coarse step / dt_min | [ndim]
+    recording recordMode = recording::all;  // Recorded steps  | -
+    std::size_t recordStride = 10;  // recording::stride         | steps
+    double recordSpacing = 100;     // recording::spacing        | m
+    double recordTolerance = 1;     // recording::simplify       | m
 
     static constexpr double timeMultiplier = 2.75;
     // For some reason the game has a different shell multiplier than the
@@ -60,33 +133,78 @@ class shellCalc {
     double dtf = 0.0001;
     double xf0 = 0, yf0 = 0;
 
-    static_assert(sizeof(double) == 8,
-                  "Size of double is not 8 - required for vectorization");
-    // Use float64 in the future
-    static_assert(std::numeric_limits<double>::is_iec559,
+    static_assert(std::is_same_v<Real, double> || std::is_same_v<Real, float>,
+                  "Only float and double are vectorized");
+    static_assert(std::numeric_limits<Real>::is_iec559,
                   "Type is not IEE754 compliant");
+    static constexpr bool isFloat = std::is_same_v<Real, float>;
 // For setting up vectorization lane widths
-#ifdef __AVX2__
-    using VT = Vec4d;
-    using VTb = Vec4db;
-#elif defined(__SSE4_1__) || defined(__AVX__)
-    using VT = Vec2d;
-    using VTb = Vec2db;
+#if WOWS_SHELL_INSTRSET >= 9
+    using VT = std::conditional_t<isFloat, Vec16f, Vec8d>;
+    using VTb = std::conditional_t<isFloat, Vec16fb, Vec8db>;
+#elif WOWS_SHELL_INSTRSET >= 8
+    using VT = std::conditional_t<isFloat, Vec8f, Vec4d>;
+    using VTb = std::conditional_t<isFloat, Vec8fb, Vec4db>;
+#elif WOWS_SHELL_INSTRSET >= 5
+    using VT = std::conditional_t<isFloat, Vec4f, Vec2d>;
+    using VTb = std::conditional_t<isFloat, Vec4fb, Vec2db>;
 #endif
-#ifdef __AVX2__
-    static constexpr std::size_t vSize = (256 / 8) / sizeof(double);
+#if WOWS_SHELL_INSTRSET >= 9
+    static constexpr std::size_t vSize = (512 / 8) / sizeof(Real);
+#elif WOWS_SHELL_INSTRSET >= 8
+    static constexpr std::size_t vSize = (256 / 8) / sizeof(Real);
 #else
-    static constexpr std::size_t vSize = (128 / 8) / sizeof(double);
+    static constexpr std::size_t vSize = (128 / 8) / sizeof(Real);
 #endif
-    static constexpr std::size_t minTasksPerThread = vSize;
+    // 0, 1, ..., vSize - 1 - offsets of each lane within a group
+    static constexpr std::array<Real, vSize> laneIndices = []() {
+        std::array<Real, vSize> indices{};
+        for (std::size_t i = 0; i < vSize; ++i) indices[i] = i;
+        return indices;
+    }();
+    // Groups of vSize rows handed out per task when refilling lanes
+    static constexpr std::size_t refillGroups = 8;
+    // Columns holding the final state of refilled lanes until the impact
+    // columns are computed from them
+    static constexpr auto parkedV_x =
+        impact::impactIndices::impactAngleHorizontalRadians;
+    static constexpr auto parkedV_y = impact::impactIndices::impactVelocity;
+    static constexpr auto parkedTime = impact::impactIndices::timeToTarget;
+    static inline noVisitor unvisited{};
+
+   public:
+    // State of a vector group after an integration step - only lanes that
+    // stepped hold a row. The step that crosses the water line is the last
+    // of a row, before the exact crossing is located.
+    struct stepState {
+        std::array<const shell *, vSize> shells;
+        std::array<std::size_t, vSize> rows;
+        std::array<Real, vSize> x, y, v_x, v_y, t;
+        std::array<bool, vSize> stepped;
+    };
+
+   private:
 
     // multithreading
-    mutable utility::threadPool tp;
-    bool enableMultiThreading = false;
-    mutable std::atomic<std::size_t> counter{0};
+    // May be shared with other calculators - see get_threadPool
+    std::shared_ptr<utility::threadPool> tp;
+    std::size_t threadBudget;
+    // Calls with fewer tasks (vector groups) per thread use fewer threads -
+    // at most this many tasks run inline on the calling thread
+    std::size_t minTasksPerThread = vSize;
+
+    // Results of earlier calls keyed by the shell, the settings they depend
+    // on and their arguments - see set_cacheSize
+    struct cachedResult {
+        std::size_t size, sizeAligned;
+        std::vector<Real> data;
+        // Only kept for impacts computed with AddTraj
+        trajectoryArena<Real> trajectories{};
+    };
+    mutable utility::lruCache<std::string, cachedResult> cache;
 
    public:
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
     VT calcNormalizationR(
         const VT angle,
         const double normalizationR) const noexcept {  // Input in radians
@@ -104,9 +222,55 @@ class shellCalc {
 
     int signum(double x) const noexcept { return ((0.0) < x) - (x < (0.0)); }
 
-    shellCalc(std::size_t numThreads = std::thread::hardware_concurrency())
-        : tp(numThreads) {
-        enableMultiThreading = numThreads > 1;
+    // Air density at altitude y                        | kg/m^3
+#if WOWS_SHELL_INSTRSET >= 5
+    VT airDensity(const VT y) const noexcept {
+        const auto exact = [](const VT y) {
+            const VT T = mul_add(VT(0 - L), y, VT(t0));
+            const VT p = VT(p0) * pow(T / VT(t0), gMRL);
+            return VT(M) * p / (VT(R) * T);
+        };
+        if constexpr (Atmosphere == atmosphere::exact) {
+            return exact(y);
+        } else {
+            const VT x = mul_add(y, VT(2 / densityFitHeight), VT(-1));
+            VT rho(densityCoeffs[0]);
+            for (std::size_t i = 1; i <= densityDegree; ++i)
+                rho = mul_add(rho, x, VT(densityCoeffs[i]));
+            const auto above = y > VT(densityFitHeight);
+            if (horizontal_or(above)) rho = select(above, exact(y), rho);
+            return rho;
+        }
+    }
+#endif
+    double airDensity(const double y) const noexcept {
+        if constexpr (Atmosphere == atmosphere::polynomial) {
+            if (y <= densityFitHeight) {
+                const double x = 2 * y / densityFitHeight - 1;
+                double rho = densityCoeffs[0];
+                for (std::size_t i = 1; i <= densityDegree; ++i)
+                    rho = std::fma(rho, x, densityCoeffs[i]);
+                return rho;
+            }
+        }
+        const double T = t0 - L * y;
+        const double p = p0 * pow(T / t0, gMRL);
+        return p * M / (R * T);
+    }
+
+    basic_shellCalc(
+        std::size_t numThreads = std::thread::hardware_concurrency())
+        : basic_shellCalc(std::make_shared<utility::threadPool>(numThreads)) {}
+
+    // Runs on a pool shared with other calculators - threadBudget caps the
+    // threads each of its calls takes from the pool (0 - the whole pool)
+    basic_shellCalc(std::shared_ptr<utility::threadPool> pool,
+                    const std::size_t threadBudget = 0)
+        : tp(std::move(pool)),
+          threadBudget(threadBudget ? threadBudget : tp->size()) {
+        if constexpr (Atmosphere == atmosphere::polynomial) {
+            densityCoeffs = fitDensity();
+        }
     }
     // Replace with setter in the future
     void editTestParameters(const double max, const double min,
@@ -131,34 +295,125 @@ class shellCalc {
     void set_x0(const double x0) { this->x0 = x0; }
     void set_y0(const double y0) { this->y0 = y0; }
     void set_dt_min(const double dt) { this->dt_min = dt; }
+    void set_tolerance(const double tolerance) { this->tolerance = tolerance; }
+    void set_exactImpact(const bool exactImpact) {
+        this->exactImpact = exactImpact;
+    }
+    void set_laneRefill(const bool laneRefill) {
+        this->laneRefill = laneRefill;
+    }
+    void set_solveTolerance(const double solveTolerance) {
+        this->solveTolerance = solveTolerance;
+    }
+    // Hybrid keeps the chosen method and lengthens its step to hybridScale *
+    // dt_min wherever a whole step stays above hybridHeight - it does not
+    // switch to a cheaper method mid-course. Only Forward Euler and Runge
+    // Kutta 2 and 4 take coarse steps, and trajectories whose apex stays
+    // below hybridHeight take none, so lower it for flat fire. See
+    // src/test/hybridTest.cpp for the step counts.
+    void set_hybridHeight(const double hybridHeight) {
+        this->hybridHeight = hybridHeight;
+    }
+    void set_hybridScale(const double hybridScale) {
+        this->hybridScale = hybridScale;
+    }
+    void set_recordMode(const recording recordMode) {
+        this->recordMode = recordMode;
+    }
+    void set_recordStride(const std::size_t recordStride) {
+        this->recordStride = recordStride;
+    }
+    void set_recordSpacing(const double recordSpacing) {
+        this->recordSpacing = recordSpacing;
+    }
+    void set_recordTolerance(const double recordTolerance) {
+        this->recordTolerance = recordTolerance;
+    }
     void set_xf0(const double xf0) { this->xf0 = xf0; }
     void set_yf0(const double yf0) { this->yf0 = yf0; }
     void set_dtf(const double dtf) { this->dtf = dtf; }
 
+    // Keeps the results of the last cacheSize calls - repeating a call with
+    // the same shell, settings and arguments copies them instead of
+    // recomputing. 0 disables the cache.
+    void set_cacheSize(const std::size_t cacheSize) {
+        cache.set_capacity(cacheSize);
+    }
+    void clearCache() { cache.clear(); }
+
+    // Most threads a call uses, including the calling thread, whatever
+    // nThreads it asks for (0 - the whole pool)
+    void set_threadBudget(const std::size_t threadBudget) {
+        this->threadBudget = threadBudget ? threadBudget : tp->size();
+    }
+    void set_minTasksPerThread(const std::size_t minTasksPerThread) {
+        this->minTasksPerThread = std::max<std::size_t>(minTasksPerThread, 1);
+    }
+    std::shared_ptr<utility::threadPool> get_threadPool() const { return tp; }
+    std::size_t get_cacheHits() const { return cache.get_hits(); }
+    std::size_t get_cacheMisses() const { return cache.get_misses(); }
+
    private:
     // Utility functions
+    // Interpolates the barometric formula at the Chebyshev nodes of
+    // [0, densityFitHeight] - near minimax - and expands the Chebyshev series
+    // into monomials for Horner's method
+    static std::array<double, densityDegree + 1> fitDensity() {
+        constexpr std::size_t N = densityDegree + 1;
+        std::array<double, N> rho, chebyshev{};
+        for (std::size_t j = 0; j < N; ++j) {
+            const double x = cos(M_PI * (j + .5) / N);
+            const double y = (x + 1) / 2 * densityFitHeight;
+            const double T = t0 - L * y;
+            rho[j] = p0 * pow(T / t0, gMRL) * M / (R * T);
+        }
+        for (std::size_t k = 0; k < N; ++k) {
+            for (std::size_t j = 0; j < N; ++j)
+                chebyshev[k] += rho[j] * cos(M_PI * k * (j + .5) / N);
+            chebyshev[k] *= (k == 0 ? 1. : 2.) / N;
+        }
+        // T_k as monomials - lowest degree first
+        std::array<double, N> coeffs{}, previous{}, current{}, next;
+        previous[0] = 1;
+        current[1] = 1;
+        coeffs[0] = chebyshev[0];
+        for (std::size_t k = 1; k < N; ++k) {
+            for (std::size_t i = 0; i < N; ++i)
+                coeffs[i] += chebyshev[k] * current[i];
+            // T_k+1 = 2x T_k - T_k-1
+            for (std::size_t i = 0; i < N; ++i)
+                next[i] = (i > 0 ? 2 * current[i - 1] : 0) - previous[i];
+            previous = current;
+            current = next;
+        }
+        std::reverse(coeffs.begin(), coeffs.end());
+        return coeffs;
+    }
+
     // mini 'threadpool' used to kick off multithreaded functions
 
     template <typename F>
     void mtFunctionRunner(const std::size_t assigned, const std::size_t length,
-                          const std::size_t size, F function) const {
-        if (enableMultiThreading) {
-            mtFunctionRunnerSelected<true>(assigned, length, size, function);
+                          F function) const {
+        const std::size_t threads = std::min(assigned, threadBudget);
+        if (threads > 1) {
+            mtFunctionRunnerSelected<true>(threads, length, function);
         } else {
-            mtFunctionRunnerSelected<false>(assigned, length, size, function);
+            mtFunctionRunnerSelected<false>(threads, length, function);
         }
     }
 
     template <bool multiThreaded, typename F>
     void mtFunctionRunnerSelected(const std::size_t assigned,
-                                  const std::size_t length,
-                                  const std::size_t size, F function) const {
+                                  const std::size_t length, F function) const {
         if constexpr (multiThreaded) {
-            counter.store(0, std::memory_order_relaxed);
-            // finished.store(0, std::memory_order_release);
-            // std::cout << assigned << " " << length << "\n";
-            tp.start([&, length](const std::size_t id) {
-                mtWorker(length, id, function);
+            // Each call splits its own range - concurrent calls can share
+            // the calculator and its pool. Grains of 1/16 of a thread's
+            // share leave enough behind to steal.
+            const std::size_t grain =
+                std::max<std::size_t>(1, length / (assigned * 16));
+            tp->parallelFor(length, assigned, grain, [&](const std::size_t i) {
+                function(i * vSize);
             });
         } else {
             for (std::size_t i = 0; i < length; ++i) {
@@ -167,20 +422,6 @@ class shellCalc {
         }
     }
 
-    template <typename F>
-    void mtWorker(const std::size_t length, const std::size_t threadID,
-                  F function) const {
-        // threadID is largely there for debugging
-        // std::cout << threadID << " " << length << "\n";
-        while (counter.load(std::memory_order_relaxed) < length) {
-            std::size_t index = counter.fetch_add(1, std::memory_order_acq_rel);
-            if (index < length) {
-                // std::cout<<index<<"\n";
-                function(index * vSize);
-            }
-        }
-    }
-
     std::size_t assignThreadNum(std::size_t length,
                                 std::size_t nThreads) const noexcept {
         if (length > nThreads * minTasksPerThread) {
@@ -198,84 +439,239 @@ class shellCalc {
         return sum == divisor;
     }
 
-    template <bool AddTraj, numerical Numerical>
-    void multiTraj(const std::size_t start, shell &s,
-                   std::array<double, 3 * vSize> &velocities) const {
-        const double k = s.get_k(), cw_2 = s.get_cw_2();
+    // Rows [begin, end) of one shell
+    struct rowRange {
+        shell *s;
+        std::size_t begin, end;
+    };
+
+    // Lanes hold the rows of ranges in order - lanes left without a row stay
+    // idle. With Refill a lane that lands is retired - its raw final state
+    // parked in the impact columns - and loaded with the next pending row,
+    // which may belong to another shell: drag is kept per lane. Multistep
+    // histories can't be restarted, so multistep callers never hand out
+    // more than vSize rows with Refill. Locate forces exactImpact.
+    // With Hybrid the single step methods take steps of hybridScale * dt_min
+    // through the mid-course - wherever the whole step stays above
+    // hybridHeight - and dt_min near launch and the water line. Multistep
+    // histories need a constant step and the adaptive methods size their
+    // own steps, so both ignore Hybrid.
+    // visitor(stepState) is called after every step - see calculateImpact
+    template <bool AddTraj, numerical Numerical, bool Hybrid,
+              bool Refill = false, bool Locate = false,
+              typename Visitor = noVisitor>
+    void multiTraj(const rowRange *ranges, const std::size_t nRanges,
+                   std::array<Real, 3 * vSize> &velocities,
+                   Visitor &visitor = unvisited) const {
+        constexpr bool visited = !std::is_same_v<Visitor, noVisitor>;
+        constexpr bool visitSteps = AddTraj || visited;
+        const bool locate = Locate || exactImpact;
+        constexpr bool hybridSteps = Hybrid && !isMultistep<Numerical>() &&
+                                     !isAdaptive<Numerical>();
+        const Real dtCoarse = dt_min * hybridScale;
         // std::cout << start << "\n";
-        if constexpr (AddTraj) {
-            for (uint32_t i = 0, j = start; i < vSize; ++i, ++j) {
-                if (j < s.impactSize) {
-                    s.trajectories[2 * (j)].clear();
-                    s.trajectories[2 * (j) + 1].clear();
-                    s.trajectories[2 * (j)].push_back(x0);
-                    s.trajectories[2 * (j) + 1].push_back(y0);
+        constexpr std::size_t idleRow = std::numeric_limits<std::size_t>::max();
+        std::array<shell *, vSize> shells{};
+        std::array<std::size_t, vSize> rows;
+        std::array<Real, vSize> kLanes{}, cw_2Lanes{};
+        std::size_t range = 0, next = ranges[0].begin;
+        // Hands lane i the next pending row - false once ranges run out
+        const auto take = [&](const uint32_t i) -> bool {
+            while (range < nRanges && next >= ranges[range].end) {
+                if (++range < nRanges) next = ranges[range].begin;
+            }
+            if (range == nRanges) {
+                rows[i] = idleRow;
+                return false;
+            }
+            shells[i] = ranges[range].s;
+            rows[i] = next++;
+            kLanes[i] = shells[i]->get_k();
+            cw_2Lanes[i] = shells[i]->get_cw_2();
+            return true;
+        };
+        for (uint32_t i = 0; i < vSize; ++i) take(i);
+
+        // Recording state of each lane - the last kept point and, for
+        // simplify, the latest step and the range of slopes from the last
+        // kept point that pass within recordTolerance of every step since
+        std::array<std::size_t, vSize> sinceKept{};
+        std::array<Real, vSize> keptX, keptY, latestX, latestY, lower, upper;
+        const Real inf = std::numeric_limits<Real>::infinity();
+        const auto keep = [&](const uint32_t i, const Real x, const Real y) {
+            shells[i]->trajectories.push_back(rows[i], x, y);
+            keptX[i] = x, keptY[i] = y, sinceKept[i] = 0;
+            lower[i] = -inf, upper[i] = inf;
+        };
+        const auto startTraj = [&](const uint32_t i) {
+            if constexpr (AddTraj) {
+                shells[i]->trajectories.clear(rows[i]);
+                keep(i, x0, y0);
+                latestX[i] = x0, latestY[i] = y0;
+            }
+        };
+        // Keeps the latest step of lane i if the recording mode asks for it
+        const auto record = [&](const uint32_t i, const Real x, const Real y) {
+            const bool last = y < 0;  // step that crossed the water line
+            switch (recordMode) {
+                case recording::all:
+                    keep(i, x, y);
+                    break;
+                case recording::stride:
+                    if (last || ++sinceKept[i] >= recordStride) keep(i, x, y);
+                    break;
+                case recording::spacing: {
+                    const Real dx = x - keptX[i], dy = y - keptY[i];
+                    if (last || sqrt(dx * dx + dy * dy) >= recordSpacing)
+                        keep(i, x, y);
+                    break;
+                }
+                case recording::simplify: {
+                    // x only increases - a step that can't be joined to the
+                    // last kept point without missing a step in between
+                    // keeps the previous step instead
+                    Real dx = x - keptX[i];
+                    if (dx > 0) {
+                        const Real slope = (y - keptY[i]) / dx;
+                        if (slope < lower[i] || slope > upper[i]) {
+                            keep(i, latestX[i], latestY[i]);
+                            dx = x - keptX[i];
+                        }
+                    }
+                    if (dx > 0) {
+                        lower[i] = std::max<Real>(
+                            lower[i], (y - recordTolerance - keptY[i]) / dx);
+                        upper[i] = std::min<Real>(
+                            upper[i], (y + recordTolerance - keptY[i]) / dx);
+                    }
+                    latestX[i] = x, latestY[i] = y;
+                    if (last) keep(i, x, y);
+                    break;
                 }
             }
+        };
+        const auto launch = [&](const uint32_t i, Real &v_x, Real &v_y) {
+            const Real radianLaunch =
+                shells[i]->get_impact(rows[i],
+                                      impact::impactIndices::launchAngle) *
+                M_PI / 180;
+            v_x = shells[i]->get_v0() * cos(radianLaunch);
+            v_y = shells[i]->get_v0() * sin(radianLaunch);
+        };
+        const auto retire = [&](const uint32_t i, const Real x, const Real v_x,
+                                const Real v_y, const Real t) {
+            shell &s = *shells[i];
+            s.get_impact(rows[i], impact::impactIndices::distance) = x;
+            s.get_impact(rows[i], parkedV_x) = v_x;
+            s.get_impact(rows[i], parkedV_y) = v_y;
+            s.get_impact(rows[i], parkedTime) = t;
+        };
+
+        for (uint32_t i = 0; i < vSize; ++i) {
+            if (rows[i] == idleRow) continue;
+            startTraj(i);
+            if constexpr (Refill) {
+                launch(i, velocities[i], velocities[i + vSize]);
+                velocities[i + vSize * 2] = 0;
+            }
         }
-#if defined(__SSE4_1__) || defined(__AVX__)
-        VT v_xR, v_yR, tR, xR(x0), yR;
+#if WOWS_SHELL_INSTRSET >= 5
+        VT v_xR, v_yR, tR, xR(x0), yR, kR;
         v_xR.load(&velocities[vSize * 0]);
         v_yR.load(&velocities[vSize * 1]);
         tR.load(&velocities[vSize * 2]);
-#ifdef __AVX2__
-        yR = VT(start + 0 < s.impactSize ? y0 : -1,
-                start + 1 < s.impactSize ? y0 : -1,
-                start + 2 < s.impactSize ? y0 : -1,
-                start + 3 < s.impactSize ? y0 : -1);
-#else
-        yR = VT(start + 0 < s.impactSize ? y0 : -1,
-                start + 1 < s.impactSize ? y0 : -1);
-#endif
-        const auto checkContinue = [&]() -> bool {
-            const auto checked = yR >= VT(0);
-            const auto res = horizontal_or(checked);
-            return res;
-        };
+        kR.load(kLanes.data());
+        {
+            std::array<Real, vSize> y;
+            for (uint32_t i = 0; i < vSize; ++i)
+                y[i] = rows[i] != idleRow ? y0 : -1;
+            yR.load(y.data());
+        }
+        // State before the latest step of each lane - the last step of a
+        // lane is the one that crosses the water line
+        VT xP(xR), yP(yR), v_xP(v_xR), v_yP(v_yR), tP(tR);
+        auto stepped = yR >= VT(0), busy = stepped;
+        VTb refilled(false);
+        VT dtStep(dt_min);  // Step of each lane
 #else
-        std::array<double, 2 * vSize> xy{};
-        for (uint32_t i = 0, j = start; i < vSize; ++i, ++j) {
-            xy[i + vSize] = j < s.impactSize ? 0 : -1;
+        std::array<Real, 2 * vSize> xy;
+        for (uint32_t i = 0; i < vSize; ++i) {
+            xy[i] = x0;
+            xy[i + vSize] = rows[i] != idleRow ? y0 : -1;
         }
 
-        const auto checkContinue = [&]() -> bool {
-            bool any = false;
-            for (uint32_t i = 0; i < vSize; ++i) {
-                any |= (xy[i + vSize] >= 0);
-            }
-            return any;
+        // State before the latest step of each lane - the last step of a
+        // lane is the one that crosses the water line
+        std::array<Real, 2 * vSize> xyP = xy;
+        std::array<Real, 3 * vSize> velocitiesP = velocities;
+        std::array<bool, vSize> stepped{}, refilled{};
+        // Step and drag of the lane being advanced
+        Real dtStep = dt_min, k = kLanes[0], cw_2 = cw_2Lanes[0];
+        const auto selectLane = [&](const uint32_t i) {
+            k = kLanes[i], cw_2 = cw_2Lanes[i];
         };
 #endif
 
-        const auto addTrajFunction = [&]() {
-            const uint32_t loopSize =
-                std::min<uint32_t>(vSize, s.impactSize - start);
-            for (uint32_t i = 0, j = start; i < loopSize; ++i, ++j) {
-#if defined(__SSE4_1__) || defined(__AVX__)
-                s.trajectories[2 * (j)].push_back(xR[i]);
-                s.trajectories[2 * (j) + 1].push_back(yR[i]);
+        const auto visitStep = [&]() {
+            if constexpr (AddTraj) {
+                // Landed lanes repeat their last point, as they always have,
+                // unless the crossing is located - it then ends the
+                // trajectory - or recordings are thinned. Lanes that didn't
+                // advance otherwise (rejected steps, idle lanes) are skipped.
+                const bool repeatLanded =
+                    !locate && recordMode == recording::all;
+                for (uint32_t i = 0; i < vSize; ++i) {
+#if WOWS_SHELL_INSTRSET >= 5
+                    const Real x = xR[i], y = yR[i];
 #else
-                s.trajectories[2 * (j)].push_back(xy[i]);
-                s.trajectories[2 * (j) + 1].push_back(xy[i + vSize]);
+                    const Real x = xy[i], y = xy[i + vSize];
 #endif
+                    const bool landed = rows[i] != idleRow && y < 0;
+                    if (stepped[i] || (repeatLanded && landed)) record(i, x, y);
+                }
+            }
+            if constexpr (visited) {
+                stepState step;
+                for (uint32_t i = 0; i < vSize; ++i) {
+                    step.shells[i] = shells[i];
+                    step.rows[i] = rows[i];
+                    step.stepped[i] = stepped[i];
+                }
+#if WOWS_SHELL_INSTRSET >= 5
+                xR.store(step.x.data());
+                yR.store(step.y.data());
+                v_xR.store(step.v_x.data());
+                v_yR.store(step.v_y.data());
+                tR.store(step.t.data());
+#else
+                std::copy_n(&xy[0], vSize, step.x.data());
+                std::copy_n(&xy[vSize], vSize, step.y.data());
+                std::copy_n(&velocities[0], vSize, step.v_x.data());
+                std::copy_n(&velocities[vSize], vSize, step.v_y.data());
+                std::copy_n(&velocities[vSize * 2], vSize, step.t.data());
+#endif
+                visitor(static_cast<const stepState &>(step));
             }
         };
 
 // Helpers
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
         const auto delta = [&](const VT x, VT &dx, VT y, VT &dy, const VT v_x,
                                VT &ddx, const VT v_y, VT &ddy,
-                               VT update = VT(0)) {
-            update = static_cast<VT>(y >= VT(0)) | update;
-            const VT dt_update = update & VT(dt_min);
+                               VTb update = VTb(false)) {
+            update = (y >= VT(0)) | update;
+            const VT dt_update = select(update, dtStep, VT(0));
             dx = dt_update * v_x;
             dy = dt_update * v_y;
-            y += dy;
+            // Density is taken a fine step ahead - coarse Hybrid steps then
+            // follow the same model as fine ones
+            if constexpr (hybridSteps) {
+                y += VT(dt_min) * v_y;
+            } else {
+                y += dy;
+            }
 
-            const VT T = mul_add(VT(0 - L), y, VT(t0));
-            const VT p = VT(p0) * pow(T / VT(t0), gMRL);
-            const VT rho = VT(M) * p / (VT(R) * T);
-            const VT kRho = VT(k) * rho;
+            const VT kRho = kR * airDensity(y);
             const VT speed = sqrt(v_x * v_x + v_y * v_y);
             const VT n_dt_update = VT(0) - dt_update;
             ddx = n_dt_update * kRho * VT(cw_1) * v_x * speed;
@@ -284,31 +680,64 @@ class shellCalc {
             // ddy[0]
             //          << "\n";
         };
+
+        // Derivatives of the velocities - used by the adaptive methods which
+        // scale by a per lane time step themselves
+        const auto acceleration = [&](const VT y, const VT v_x, const VT v_y,
+                                      VT &a_x, VT &a_y) {
+            const VT kRho = kR * airDensity(y);
+            const VT speed = sqrt(v_x * v_x + v_y * v_y);
+            a_x = VT(0) - kRho * VT(cw_1) * v_x * speed;
+            a_y = VT(0) - (g + (kRho * VT(cw_1) * v_y * speed));
+        };
+
+        const auto hybridStep = [&](const VT y, const VT v_y) -> VT {
+            const auto coarse =
+                (y >= VT(hybridHeight)) &
+                (mul_add(v_y, VT(dtCoarse), y) >= VT(hybridHeight));
+            return select(coarse, VT(dtCoarse), VT(dt_min));
+        };
 #else
-        const auto delta = [&](const double x, double &dx, double y, double &dy,
-                               const double v_x, double &ddx, const double v_y,
-                               double &ddy, bool update = false) {
+        const auto delta = [&](const Real x, Real &dx, Real y, Real &dy,
+                               const Real v_x, Real &ddx, const Real v_y,
+                               Real &ddy, bool update = false) {
             update |= (y >= 0);
-            const double dt_update = update * dt_min;
+            const Real dt_update = update * dtStep;
             dx = dt_update * v_x;
             dy = dt_update * v_y;
-            y += dy;  // x not needed
-            // Air Density
-            const double T = t0 - L * y;
-            const double p = p0 * pow(T / t0, gMRL);
-            const double rho = p * M / (R * T);
-            const double kRho = k * rho;
+            // x not needed - see the vectorized delta
+            if constexpr (hybridSteps) {
+                y += dt_min * v_y;
+            } else {
+                y += dy;
+            }
+            const Real kRho = k * airDensity(y);
             // Calculate Drag Components
-            const double speed = sqrt(v_x * v_x + v_y * v_y);
+            const Real speed = sqrt(v_x * v_x + v_y * v_y);
             ddx = -1 * dt_update * kRho * (cw_1 * v_x * speed + cw_2 * v_x);
             ddy = -1 * dt_update *
                   (g + kRho * (cw_1 * v_y * speed
                                //+ cw_2 * fabs(v_y) * signum(v_y)
                                ));
         };
+
+        const auto acceleration = [&](const Real y, const Real v_x,
+                                      const Real v_y, Real &a_x,
+                                      Real &a_y) {
+            const Real kRho = k * airDensity(y);
+            const Real speed = sqrt(v_x * v_x + v_y * v_y);
+            a_x = -1 * kRho * (cw_1 * v_x * speed + cw_2 * v_x);
+            a_y = -1 * (g + kRho * cw_1 * v_y * speed);
+        };
+
+        const auto hybridStep = [&](const Real y, const Real v_y) -> Real {
+            const bool coarse = y >= hybridHeight &&
+                                y + v_y * dtCoarse >= hybridHeight;
+            return coarse ? dtCoarse : dt_min;
+        };
 #endif
 
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
         const auto RK4Final = [&](std::array<VT, 4> &d) -> VT {
             // Adds deltas in Runge Kutta 4 manner
             return mul_add(VT(2), d[1] + d[2], d[0] + d[3]) / VT(6);
@@ -316,15 +745,15 @@ class shellCalc {
 
         const auto RK2Final = [&](std::array<VT, 2> &d) -> VT {
             // Adds deltas in Runge Kutta 2 manner
-            return mul_add(VT(0.5), d[1], d[0]);
+            return (d[0] + d[1]) * VT(0.5);
         };
 #else
         const auto getIntermediate = [](uint32_t index, uint32_t stage) {
             return index + stage * vSize;
         };
 
-        const auto RK4Final = [&](std::array<double, 4 * vSize> &d,
-                                  uint32_t index) -> double {
+        const auto RK4Final = [&](std::array<Real, 4 * vSize> &d,
+                                  uint32_t index) -> Real {
             // Adds deltas in Runge Kutta 4 manner
             return (std::fma(2, d[getIntermediate(index, 1)],
                              d[getIntermediate(index, 0)]) +
@@ -333,26 +762,187 @@ class shellCalc {
                    6;
         };
 
-        const auto RK2Final = [&](std::array<double, 2 * vSize> &d,
-                                  uint32_t index) -> double {
+        const auto RK2Final = [&](std::array<Real, 2 * vSize> &d,
+                                  uint32_t index) -> Real {
             // Adds deltas in Runge Kutta 2 manner
             return (d[getIntermediate(index, 0)] +
                     d[getIntermediate(index, 1)]) /
                    2;
         };
 #endif
+        // Cubic Hermite interpolation across the step that crossed the water
+        // line - positions use the velocities as slopes and velocities use
+        // the accelerations - followed by a few Newton iterations on
+        // y(s) = 0 starting from the secant estimate.
+        const auto hermite = [](const auto u, const auto h, const auto p0,
+                                const auto m0, const auto p1, const auto m1) {
+            const auto u2 = u * u, u3 = u2 * u;
+            return (2. * u3 - 3. * u2 + 1.) * p0 + (u3 - 2. * u2 + u) * h * m0 +
+                   (3. * u2 - 2. * u3) * p1 + (u3 - u2) * h * m1;
+        };
+        const auto hermiteDu = [](const auto u, const auto h, const auto p0,
+                                  const auto m0, const auto p1, const auto m1) {
+            const auto u2 = u * u;
+            return 6. * (u2 - u) * p0 + (3. * u2 - 4. * u + 1.) * h * m0 +
+                   6. * (u - u2) * p1 + (3. * u2 - 2. * u) * h * m1;
+        };
+        constexpr int newtonIterations = 3;
+#if WOWS_SHELL_INSTRSET >= 5
+        const auto locateImpact = [&]() {
+            const auto crossed = (yR < VT(0)) & (yP >= VT(0));
+            if (!horizontal_or(crossed)) return;
+            const VT h = tR - tP;
+            VT a_xP, a_yP, a_x, a_y;
+            acceleration(yP, v_xP, v_yP, a_xP, a_yP);
+            acceleration(yR, v_xR, v_yR, a_x, a_y);
+            VT sR = select(crossed, yP / (yP - yR), VT(0));
+            for (int n = 0; n < newtonIterations; ++n) {
+                const VT f = hermite(sR, h, yP, v_yP, yR, v_yR);
+                const VT df = hermiteDu(sR, h, yP, v_yP, yR, v_yR);
+                sR = select(crossed & (df != VT(0)), sR - f / df, sR);
+                sR = min(max(sR, VT(0)), VT(1));
+            }
+            xR = select(crossed, hermite(sR, h, xP, v_xP, xR, v_xR), xR);
+            const VT v_xI = hermite(sR, h, v_xP, a_xP, v_xR, a_x);
+            const VT v_yI = hermite(sR, h, v_yP, a_yP, v_yR, a_y);
+            v_xR = select(crossed, v_xI, v_xR);
+            v_yR = select(crossed, v_yI, v_yR);
+            tR = select(crossed, mul_add(sR, h, tP), tR);
+            if constexpr (AddTraj) {
+                for (uint32_t i = 0; i < vSize; ++i) {
+                    if (!crossed[i]) continue;
+                    shells[i]->trajectories.set_back(rows[i], xR[i], 0);
+                }
+            }
+        };
+
+        const auto refill = [&]() {
+            refilled = VTb(false);
+            const auto landed = busy & (yR < VT(0));
+            if (!horizontal_or(landed)) return;
+            if (locate) locateImpact();
+            std::array<Real, vSize> loaded{}, v_x{}, v_y{};
+            for (uint32_t i = 0; i < vSize; ++i) {
+                if (!landed[i]) continue;
+                retire(i, xR[i], v_xR[i], v_yR[i], tR[i]);
+                if (take(i)) {
+                    launch(i, v_x[i], v_y[i]);
+                    startTraj(i);
+                    loaded[i] = 1;
+                }
+            }
+            refilled = VT().load(loaded.data()) != VT(0);
+            kR.load(kLanes.data());
+            const auto idled = landed & ~refilled;
+            xR = select(refilled, VT(x0), xR);
+            yR = select(refilled, VT(y0), yR);
+            v_xR = select(refilled, VT().load(v_x.data()), v_xR);
+            v_yR = select(refilled, VT().load(v_y.data()), v_yR);
+            tR = select(refilled, VT(0), tR);
+            yP = select(idled, VT(-1), yP);
+            busy = busy & ~idled;
+        };
+
+        const auto checkContinue = [&]() -> bool {
+            if constexpr (Refill) refill();
+            const auto checked = yR >= VT(0);
+            if (locate) {
+                xP = select(checked, xR, xP);
+                yP = select(checked, yR, yP);
+                v_xP = select(checked, v_xR, v_xP);
+                v_yP = select(checked, v_yR, v_yP);
+                tP = select(checked, tR, tP);
+            }
+            stepped = checked;
+            const auto res = horizontal_or(checked);
+            return res;
+        };
+#else
+        const auto locateImpact = [&]() {
+            for (uint32_t i = 0; i < vSize; ++i) {
+                Real &x = xy[i], &y = xy[i + vSize], &v_x = velocities[i],
+                       &v_y = velocities[i + vSize],
+                       &t = velocities[i + vSize * 2];
+                const Real xP = xyP[i], yP = xyP[i + vSize],
+                             v_xP = velocitiesP[i],
+                             v_yP = velocitiesP[i + vSize],
+                             tP = velocitiesP[i + vSize * 2];
+                if (!(y < 0 && yP >= 0)) continue;
+                selectLane(i);
+                const Real h = t - tP;
+                Real a_xP, a_yP, a_x, a_y;
+                acceleration(yP, v_xP, v_yP, a_xP, a_yP);
+                acceleration(y, v_x, v_y, a_x, a_y);
+                Real sI = yP / (yP - y);
+                for (int n = 0; n < newtonIterations; ++n) {
+                    const Real f = hermite(sI, h, yP, v_yP, y, v_y);
+                    const Real df = hermiteDu(sI, h, yP, v_yP, y, v_y);
+                    if (df != 0) sI -= f / df;
+                    sI = std::min<Real>(std::max<Real>(sI, 0), 1);
+                }
+                x = hermite(sI, h, xP, v_xP, x, v_x);
+                const Real v_xI = hermite(sI, h, v_xP, a_xP, v_x, a_x);
+                const Real v_yI = hermite(sI, h, v_yP, a_yP, v_y, a_y);
+                v_x = v_xI, v_y = v_yI;
+                t = tP + sI * h;
+                if constexpr (AddTraj) {
+                    shells[i]->trajectories.set_back(rows[i], x, 0);
+                }
+            }
+        };
+
+        const auto refill = [&]() {
+            refilled.fill(false);
+            bool anyLanded = false;
+            for (uint32_t i = 0; i < vSize; ++i)
+                anyLanded |= rows[i] != idleRow && xy[i + vSize] < 0;
+            if (!anyLanded) return;
+            if (locate) locateImpact();
+            for (uint32_t i = 0; i < vSize; ++i) {
+                Real &x = xy[i], &y = xy[i + vSize], &v_x = velocities[i],
+                       &v_y = velocities[i + vSize],
+                       &t = velocities[i + vSize * 2];
+                if (rows[i] == idleRow || y >= 0) continue;
+                retire(i, x, v_x, v_y, t);
+                if (take(i)) {
+                    launch(i, v_x, v_y);
+                    startTraj(i);
+                    x = x0, y = y0, t = 0;
+                    refilled[i] = true;
+                } else {
+                    xyP[i + vSize] = -1;
+                }
+            }
+        };
+
+        const auto checkContinue = [&]() -> bool {
+            if constexpr (Refill) refill();
+            bool any = false;
+            for (uint32_t i = 0; i < vSize; ++i) {
+                stepped[i] = (xy[i + vSize] >= 0);
+                if (locate && stepped[i]) {
+                    xyP[i] = xy[i], xyP[i + vSize] = xy[i + vSize];
+                    for (uint32_t j = 0; j < 3; ++j)
+                        velocitiesP[i + j * vSize] = velocities[i + j * vSize];
+                }
+                any |= stepped[i];
+            }
+            return any;
+        };
+#endif
+
         // TODO: Add numerical orders
         if constexpr (isMultistep<Numerical>()) {
             if constexpr (Numerical == numerical::adamsBashforth5) {
                 uint32_t offset = 0;  // Make it a circular buffer
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
                 std::array<VT, 5> dx, dy, ddx, ddy;
                 const auto get = [&](const uint32_t &stage) -> uint32_t {
                     return (stage + offset) % 5;
                 };
                 std::array<VT, 2> rdx, rdy, rddx, rddy;
 #else
-                std::array<double, 5 * vSize> dx, dy, ddx, ddy;
+                std::array<Real, 5 * vSize> dx, dy, ddx, ddy;
                 // 0 -> vSize -> ... -> 5 * vSize
 
                 auto get = [&](const uint32_t &index,
@@ -361,12 +951,12 @@ class shellCalc {
                 };
 
                 // Fill in first 5 w/ RK2
-                std::array<double, 2 * vSize> rdx, rdy, rddx, rddy;
+                std::array<Real, 2 * vSize> rdx, rdy, rddx, rddy;
 #endif
                 for (int stage = 0; (stage < 4) & checkContinue(); ++stage) {
-#if defined(__SSE4_1__) || defined(__AVX__)
-                    VT update = static_cast<VT>(yR >= VT(0));
-                    VT dt_update = update & VT(dt_min);
+#if WOWS_SHELL_INSTRSET >= 5
+                    const VTb update = yR >= VT(0);
+                    const VT dt_update = select(update, VT(dt_min), VT(0));
                     delta(xR, rdx[0], yR, rdy[0], v_xR, rddx[0], v_yR, rddy[0]);
                     delta((xR + rdx[0]), rdx[1], (yR + rdy[0]), rdy[1],
                           (v_xR + rddx[0]), rddx[1], (v_yR + rddy[0]), rddy[1],
@@ -384,14 +974,15 @@ class shellCalc {
                     tR += dt_update;
 #else
                     for (std::size_t i = 0; i < vSize; ++i) {
-                        double &x = xy[i], &y = xy[i + vSize],
+                        Real &x = xy[i], &y = xy[i + vSize],
                                &v_x = velocities[i],
                                &v_y = velocities[i + vSize],
                                &t = velocities[i + vSize * 2];
+                        selectLane(i);
 
                         // RK2
-                        double dt_update = (y >= 0) * dt_min;
-                        // std::array<double, 2> rdx, rdy, rddx, rddy;
+                        Real dt_update = (y >= 0) * dt_min;
+                        // std::array<Real, 2> rdx, rdy, rddx, rddy;
                         auto intermediate0 = getIntermediate(i, 0),
                              intermediate1 = getIntermediate(i, 1);
                         delta(x, rdx[intermediate0], y, rdy[intermediate0], v_x,
@@ -403,7 +994,7 @@ class shellCalc {
                               y >= 0);
                         // Force update even if it becomes zero
 
-                        double fdx = RK2Final(rdx, i), fdy = RK2Final(rdy, i),
+                        Real fdx = RK2Final(rdx, i), fdy = RK2Final(rdy, i),
                                fddx = RK2Final(rddx, i),
                                fddy = RK2Final(rddy, i);
                         x += fdx;
@@ -418,8 +1009,8 @@ class shellCalc {
                         t += dt_update;
                     }
 #endif
-                    if constexpr (AddTraj) {
-                        addTrajFunction();
+                    if constexpr (visitSteps) {
+                        visitStep();
                     }
                 }
 
@@ -429,17 +1020,17 @@ class shellCalc {
                     constexpr double AB5Divisor = 720;
                     static_assert(testAnalysisCoeffs(AB5Coeffs, AB5Divisor),
                                   "Incorrect AB5 Coefficients");
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
                     const auto ABF5 = [&](const std::array<VT, 5> &d,
-                                          const VT update) {
+                                          const VTb update) {
                         VT result = VT(0);
                         for (int j = 0; j < 5; ++j)
                             result =
                                 mul_add(VT(AB5Coeffs[j]), d[get(j)], result);
-                        return (result / VT(AB5Divisor)) & update;
+                        return select(update, result / VT(AB5Divisor), VT(0));
                     };
-                    VT update = static_cast<VT>(yR >= VT(0));
-                    VT dt_update = update & VT(dt_min);
+                    const VTb update = yR >= VT(0);
+                    const VT dt_update = select(update, VT(dt_min), VT(0));
                     auto index = get(4);
                     delta(xR, dx[index], yR, dy[index], v_xR, ddx[index], v_yR,
                           ddy[index]);
@@ -450,18 +1041,19 @@ class shellCalc {
                     tR += dt_update;
 #else
                     const auto ABF5 =
-                        [&](const std::array<double, 5 * vSize> &d,
+                        [&](const std::array<Real, 5 * vSize> &d,
                             const uint32_t &i, const bool &update) {
-                            double result = 0;
+                            Real result = 0;
                             for (int j = 0; j < 5; ++j)
                                 result += AB5Coeffs[j] * d[get(i, j)];
                             return result / AB5Divisor * update;
                         };
                     for (uint32_t i = 0; i < vSize; ++i) {
-                        double &x = xy[i], &y = xy[i + vSize],
+                        Real &x = xy[i], &y = xy[i + vSize],
                                &v_x = velocities[i],
                                &v_y = velocities[i + vSize],
                                &t = velocities[i + vSize * 2];
+                        selectLane(i);
                         bool update = (y >= 0);
                         uint32_t index = get(i, 4);  // Write to index
                         delta(x, dx[index], y, dy[index], v_x, ddx[index], v_y,
@@ -473,8 +1065,8 @@ class shellCalc {
                         t += update * dt_min;
                     }
 #endif
-                    if constexpr (AddTraj) {
-                        addTrajFunction();
+                    if constexpr (visitSteps) {
+                        visitStep();
                     }
                     offset++;  // Circle back
                     offset = offset == 5 ? 0 : offset;
@@ -484,27 +1076,241 @@ class shellCalc {
                                   uint32_t, toUnderlying(Numerical)> >,
                               "Invalid multistep algorithm");
             }
+        } else if constexpr (isAdaptive<Numerical>()) {
+            if constexpr (Numerical == numerical::dormandPrince45) {
+                // Each lane carries its own time step - starting at dt_min -
+                // which is grown or shrunk to keep the local error estimate
+                // below tolerance. Steps that would land more than dt_min
+                // past the water line are retried with a step sized to the
+                // estimated crossing so that impacts are resolved as finely
+                // as the fixed step methods.
+                // Row i: weights of the stage i + 1 state
+                // Last row: 5th order solution - First Same As Last
+                constexpr std::array<std::array<double, 6>, 6> DP45A = {{
+                    {1. / 5},
+                    {3. / 40, 9. / 40},
+                    {44. / 45, -56. / 15, 32. / 9},
+                    {19372. / 6561, -25360. / 2187, 64448. / 6561,
+                     -212. / 729},
+                    {9017. / 3168, -355. / 33, 46732. / 5247, 49. / 176,
+                     -5103. / 18656},
+                    {35. / 384, 0, 500. / 1113, 125. / 192, -2187. / 6784,
+                     11. / 84},
+                }};
+                // 5th order weights - embedded 4th order weights
+                constexpr std::array<double, 7> DP45E = {
+                    71. / 57600,      0,         -71. / 16695, 71. / 1920,
+                    -17253. / 339200, 22. / 525, -1. / 40};
+                constexpr double safety = .9, minScale = .2, maxScale = 5;
+#if WOWS_SHELL_INSTRSET >= 5
+                VT dtR(dt_min);
+                std::array<VT, 7> kx, ky, kvx, kvy;
+                kx[0] = v_xR, ky[0] = v_yR;
+                acceleration(yR, v_xR, v_yR, kvx[0], kvy[0]);
+
+                const auto errorRatio = [&](const std::array<VT, 7> &d,
+                                            const VT previous, const VT next) {
+                    VT e(0);
+                    for (std::size_t j = 0; j < 7; ++j)
+                        e = mul_add(VT(DP45E[j]), d[j], e);
+                    const VT scale = VT(tolerance) *
+                                     (VT(1) + max(abs(previous), abs(next)));
+                    const VT r = dtR * e / scale;
+                    return r * r;
+                };
+
+                while (checkContinue()) {
+                    if constexpr (Refill) {
+                        // Refilled lanes restart from dt_min
+                        if (horizontal_or(refilled)) {
+                            VT a_x, a_y;
+                            acceleration(yR, v_xR, v_yR, a_x, a_y);
+                            dtR = select(refilled, VT(dt_min), dtR);
+                            kx[0] = select(refilled, v_xR, kx[0]);
+                            ky[0] = select(refilled, v_yR, ky[0]);
+                            kvx[0] = select(refilled, a_x, kvx[0]);
+                            kvy[0] = select(refilled, a_y, kvy[0]);
+                        }
+                    }
+                    const auto active = yR >= VT(0);
+                    VT xN, yN, v_xN, v_yN;
+                    for (std::size_t stage = 1; stage < 7; ++stage) {
+                        VT sx(0), sy(0), svx(0), svy(0);
+                        for (std::size_t j = 0; j < stage; ++j) {
+                            const VT a(DP45A[stage - 1][j]);
+                            sx = mul_add(a, kx[j], sx);
+                            sy = mul_add(a, ky[j], sy);
+                            svx = mul_add(a, kvx[j], svx);
+                            svy = mul_add(a, kvy[j], svy);
+                        }
+                        xN = mul_add(dtR, sx, xR);
+                        yN = mul_add(dtR, sy, yR);
+                        v_xN = mul_add(dtR, svx, v_xR);
+                        v_yN = mul_add(dtR, svy, v_yR);
+                        kx[stage] = v_xN, ky[stage] = v_yN;
+                        acceleration(yN, v_xN, v_yN, kvx[stage], kvy[stage]);
+                    }
+
+                    const VT error =
+                        sqrt((errorRatio(kx, xR, xN) + errorRatio(ky, yR, yN) +
+                              errorRatio(kvx, v_xR, v_xN) +
+                              errorRatio(kvy, v_yR, v_yN)) *
+                             VT(.25));
+                    const auto overshoot = (yN < VT(0)) & (dtR > VT(dt_min));
+                    const auto accept = active & (error <= VT(1)) & ~overshoot;
+
+                    const VT scaled =
+                        dtR * min(max(VT(safety) * pow(error, -.2),
+                                      VT(minScale)),
+                                  VT(maxScale));
+                    const VT crossing = max(VT(dt_min), dtR * yR / (yR - yN));
+
+                    xR = select(accept, xN, xR);
+                    yR = select(accept, yN, yR);
+                    v_xR = select(accept, v_xN, v_xR);
+                    v_yR = select(accept, v_yN, v_yR);
+                    tR = select(accept, tR + dtR, tR);
+                    kx[0] = select(accept, kx[6], kx[0]);
+                    ky[0] = select(accept, ky[6], ky[0]);
+                    kvx[0] = select(accept, kvx[6], kvx[0]);
+                    kvy[0] = select(accept, kvy[6], kvy[0]);
+                    dtR = select(overshoot, min(scaled, crossing), scaled);
+
+                    if constexpr (visitSteps) {
+                        stepped = accept;
+                        if (horizontal_or(accept)) visitStep();
+                    }
+                }
+#else
+                std::array<Real, vSize> dt;
+                dt.fill(dt_min);
+                std::array<Real, 7 * vSize> kx, ky, kvx, kvy;
+                for (uint32_t i = 0; i < vSize; ++i) {
+                    const auto first = getIntermediate(i, 0);
+                    selectLane(i);
+                    kx[first] = velocities[i];
+                    ky[first] = velocities[i + vSize];
+                    acceleration(xy[i + vSize], kx[first], ky[first],
+                                 kvx[first], kvy[first]);
+                }
+
+                while (checkContinue()) {
+                    bool accepted = false;
+                    for (uint32_t i = 0; i < vSize; ++i) {
+                        Real &x = xy[i], &y = xy[i + vSize],
+                               &v_x = velocities[i],
+                               &v_y = velocities[i + vSize],
+                               &t = velocities[i + vSize * 2];
+                        selectLane(i);
+                        if (y < 0) continue;
+                        if constexpr (Refill) {
+                            // Refilled lanes restart from dt_min
+                            if (refilled[i]) {
+                                const auto first = getIntermediate(i, 0);
+                                dt[i] = dt_min;
+                                kx[first] = v_x, ky[first] = v_y;
+                                acceleration(y, v_x, v_y, kvx[first],
+                                             kvy[first]);
+                            }
+                        }
+
+                        Real xN = x, yN = y, v_xN = v_x, v_yN = v_y;
+                        for (uint32_t stage = 1; stage < 7; ++stage) {
+                            Real sx = 0, sy = 0, svx = 0, svy = 0;
+                            for (uint32_t j = 0; j < stage; ++j) {
+                                const Real a = DP45A[stage - 1][j];
+                                const auto index = getIntermediate(i, j);
+                                sx += a * kx[index];
+                                sy += a * ky[index];
+                                svx += a * kvx[index];
+                                svy += a * kvy[index];
+                            }
+                            xN = x + dt[i] * sx;
+                            yN = y + dt[i] * sy;
+                            v_xN = v_x + dt[i] * svx;
+                            v_yN = v_y + dt[i] * svy;
+                            const auto index = getIntermediate(i, stage);
+                            kx[index] = v_xN, ky[index] = v_yN;
+                            acceleration(yN, v_xN, v_yN, kvx[index],
+                                         kvy[index]);
+                        }
+
+                        const auto errorRatio =
+                            [&](const std::array<Real, 7 * vSize> &d,
+                                const Real previous, const Real next) {
+                                Real e = 0;
+                                for (uint32_t j = 0; j < 7; ++j)
+                                    e += DP45E[j] * d[getIntermediate(i, j)];
+                                const Real r =
+                                    dt[i] * e /
+                                    (tolerance *
+                                     (1 + std::max(fabs(previous),
+                                                   fabs(next))));
+                                return r * r;
+                            };
+                        const Real error = sqrt(
+                            (errorRatio(kx, x, xN) + errorRatio(ky, y, yN) +
+                             errorRatio(kvx, v_x, v_xN) +
+                             errorRatio(kvy, v_y, v_yN)) /
+                            4);
+                        const bool overshoot = yN < 0 && dt[i] > dt_min;
+                        const bool accept = error <= 1 && !overshoot;
+
+                        Real next =
+                            dt[i] * std::min(std::max(safety * pow(error, -.2),
+                                                      minScale),
+                                             maxScale);
+                        if (overshoot) {
+                            next = std::min<Real>(
+                                next,
+                                std::max<Real>(dt_min, dt[i] * y / (y - yN)));
+                        }
+                        if (accept) {
+                            x = xN, y = yN, v_x = v_xN, v_y = v_yN;
+                            t += dt[i];
+                            const auto first = getIntermediate(i, 0),
+                                       last = getIntermediate(i, 6);
+                            kx[first] = kx[last], ky[first] = ky[last];
+                            kvx[first] = kvx[last], kvy[first] = kvy[last];
+                            accepted = true;
+                        }
+                        stepped[i] = accept;
+                        dt[i] = next;
+                    }
+                    if constexpr (visitSteps) {
+                        if (accepted) visitStep();
+                    }
+                }
+#endif
+            } else {
+                static_assert(utility::falsy_v<std::integral_constant<
+                                  uint32_t, toUnderlying(Numerical)> >,
+                              "Invalid adaptive algorithm");
+            }
         } else {
             while (checkContinue()) {
-#if defined(__SSE4_1__) || defined(__AVX__)
-                VT update = static_cast<VT>(yR >= VT(0));
-                VT dt_update = update & VT(dt_min);
+#if WOWS_SHELL_INSTRSET >= 5
+                if constexpr (hybridSteps) dtStep = hybridStep(yR, v_yR);
+                const VTb update = yR >= VT(0);
+                const VT dt_update = select(update, dtStep, VT(0));
 #endif
                 if constexpr (Numerical == numerical::forwardEuler) {
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
                     VT dx, dy, ddx, ddy;
                     delta(xR, dx, yR, dy, v_xR, ddx, v_yR, ddy);
                     xR += dx, yR += dy, v_xR += ddx, v_yR += ddy,
                         tR += dt_update;
 #else
-                    std::array<double, vSize> dx, dy, ddx, ddy;
+                    std::array<Real, vSize> dx, dy, ddx, ddy;
                     for (uint32_t i = 0; i < vSize; ++i) {
-                        double &x = xy[i], &y = xy[i + vSize],
+                        Real &x = xy[i], &y = xy[i + vSize],
                                &v_x = velocities[i],
                                &v_y = velocities[i + vSize],
                                &t = velocities[i + vSize * 2];
-                        double dt_update = (y >= 0) * dt_min;
-                        // double dx, dy, ddx, ddy;
+                        selectLane(i);
+                        if constexpr (hybridSteps) dtStep = hybridStep(y, v_y);
+                        Real dt_update = (y >= 0) * dtStep;
+                        // Real dx, dy, ddx, ddy;
 
                         delta(x, dx[i], y, dy[i], v_x, ddx[i], v_y, ddy[i]);
                         x += dx[i];
@@ -515,7 +1321,7 @@ class shellCalc {
                     }
 #endif
                 } else if constexpr (Numerical == numerical::rungeKutta2) {
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
                     std::array<VT, 2> dx, dy, ddx, ddy;
                     delta(xR, dx[0], yR, dy[0], v_xR, ddx[0], v_yR, ddy[0]);
                     delta(xR + dx[0], dx[1], yR + dy[0], dy[1], v_xR + ddx[0],
@@ -526,14 +1332,16 @@ class shellCalc {
                     v_yR += RK2Final(ddy);
                     tR += dt_update;
 #else
-                    std::array<double, 2 * vSize> dx, dy, ddx, ddy;
+                    std::array<Real, 2 * vSize> dx, dy, ddx, ddy;
                     for (uint32_t i = 0; i < vSize; ++i) {
-                        double &x = xy[i], &y = xy[i + vSize],
+                        Real &x = xy[i], &y = xy[i + vSize],
                                &v_x = velocities[i],
                                &v_y = velocities[i + vSize],
                                &t = velocities[i + vSize * 2];
-                        double dt_update = (y >= 0) * dt_min;
-                        // std::array<double, 2> dx, dy, ddx, ddy;
+                        selectLane(i);
+                        if constexpr (hybridSteps) dtStep = hybridStep(y, v_y);
+                        Real dt_update = (y >= 0) * dtStep;
+                        // std::array<Real, 2> dx, dy, ddx, ddy;
 
                         auto intermediate0 = getIntermediate(i, 0),
                              intermediate1 = getIntermediate(i, 1);
@@ -554,7 +1362,7 @@ class shellCalc {
                     }
 #endif
                 } else if constexpr (Numerical == numerical::rungeKutta4) {
-#if defined(__SSE4_1__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 5
                     std::array<VT, 4> dx, dy, ddx, ddy;
                     delta(xR, dx[0], yR, dy[0], v_xR, ddx[0], v_yR, ddy[0]);
                     for (int k = 0; k < 2; k++) {
@@ -572,16 +1380,18 @@ class shellCalc {
                     v_yR += RK4Final(ddy);
                     tR += dt_update;
 #else
-                    std::array<double, 4 * vSize> dx, dy, ddx, ddy;
+                    std::array<Real, 4 * vSize> dx, dy, ddx, ddy;
                     for (uint32_t i = 0; i < vSize; ++i) {
-                        double &x = xy[i], &y = xy[i + vSize],
+                        Real &x = xy[i], &y = xy[i + vSize],
                                &v_x = velocities[i],
                                &v_y = velocities[i + vSize],
                                &t = velocities[i + vSize * 2];
+                        selectLane(i);
                         bool update =
                             (y >= 0);  // Force update even if it becomes zero
-                        double dt_update = update * dt_min;
-                        // std::array<double, 4> dx, dy, ddx, ddy;
+                        if constexpr (hybridSteps) dtStep = hybridStep(y, v_y);
+                        Real dt_update = update * dtStep;
+                        // std::array<Real, 4> dx, dy, ddx, ddy;
                         // K1->K4
                         auto intermediate0 = getIntermediate(i, 0);
                         delta(x, dx[intermediate0], y, dy[intermediate0], v_x,
@@ -619,295 +1429,1136 @@ class shellCalc {
                                   "Invalid single step algorithm");
                 }
 
-                if constexpr (AddTraj) {
-                    addTrajFunction();
+                if constexpr (visitSteps) {
+                    visitStep();
+                }
+            }
+        }
+
+        if constexpr (Refill) return;  // Every lane has been retired
+        if (locate) locateImpact();
+
+        auto distanceTarget = ranges[0].s->get_impactPtr(
+            ranges[0].begin, impact::impactIndices::distance);
+#if WOWS_SHELL_INSTRSET >= 5
+        v_xR.store(&velocities[vSize * 0]);
+        v_yR.store(&velocities[vSize * 1]);
+        tR.store(&velocities[vSize * 2]);
+        xR.store(distanceTarget);
+#else
+        std::copy_n(xy.begin(), vSize, distanceTarget);
+#endif
+    }
+
+    // Several trajectories done in one chunk to allow for vectorization
+    template <bool AddTraj, numerical Numerical, bool Hybrid, bool Fit,
+              bool nonAP, impact::columnMask Mask = impact::allColumns,
+              typename Visitor = noVisitor>
+    void impactGroup(const std::size_t i, shell &s,
+                     Visitor &visitor = unvisited) const {
+        // std::cout<<"Entered\n";
+        std::array<Real, vSize * 3> velocitiesTime{};
+// 0 -> (v_x) -> vSize -> (v_y) -> 2*vSize -> (t) -> 3*vSize
+#if WOWS_SHELL_INSTRSET >= 6
+        const VT indices = VT().load(laneIndices.data());
+#endif
+
+#if WOWS_SHELL_INSTRSET >= 6
+        VT launch_degrees, launch_radians, v0_v, v_xv, v_yv;
+        if constexpr (!Fit) {
+            launch_degrees = VT(precision) * (VT(i) + indices) + VT(minA);
+            launch_degrees.store(
+                s.get_impactPtr(i, impact::impactIndices::launchAngle));
+        } else {
+            launch_degrees.load(
+                s.get_impactPtr(i, impact::impactIndices::launchAngle));
+        }
+        launch_radians = launch_degrees * VT(M_PI / 180);
+        v0_v = VT(s.get_v0());
+        VT cx, cy;
+        cy = sincos(&cx, launch_radians);
+        v_xv = cx * v0_v, v_yv = cy * v0_v;
+        v_xv.store(&velocitiesTime[0]);
+        v_yv.store(&velocitiesTime[vSize]);
+#else
+        for (uint32_t j = 0; j < vSize; j++) {
+            Real radianLaunch;
+            if constexpr (!Fit) {
+                Real degreeLaunch = precision * (i + j) + minA;
+                s.get_impact(i + j, impact::impactIndices::launchAngle) =
+                    degreeLaunch;
+                radianLaunch = degreeLaunch * M_PI / 180;
+            } else {
+                radianLaunch =
+                    s.get_impact(i + j, impact::impactIndices::launchAngle) *
+                    M_PI / 180;
+            }
+            velocitiesTime[j] = s.get_v0() * cos(radianLaunch);
+            velocitiesTime[j + vSize] = s.get_v0() * sin(radianLaunch);
+        }
+#endif
+        // std::cout<<"Calculating\n";
+        const rowRange range{&s, i, s.impactSize};
+        multiTraj<AddTraj, Numerical, Hybrid>(&range, 1, velocitiesTime,
+                                              visitor);
+        // std::cout<<"Processing\n";
+        impactColumns<nonAP, Mask>(i, s, velocitiesTime);
+    }
+
+    // Rows of ranges streamed through the lanes - a lane that lands is
+    // refilled with the next row instead of idling until its group lands.
+    // Ranges begin on a multiple of vSize; columns(i, s, velocitiesTime)
+    // fills the impact columns of each group afterwards.
+    template <bool AddTraj, numerical Numerical, bool Hybrid, bool Fit,
+              typename Columns, typename Visitor = noVisitor>
+    void impactRefill(const rowRange *ranges, const std::size_t nRanges,
+                      Columns columns, Visitor &visitor = unvisited) const {
+        if constexpr (!Fit) {
+            for (std::size_t r = 0; r < nRanges; ++r) {
+                for (std::size_t j = ranges[r].begin; j < ranges[r].end; ++j) {
+                    ranges[r].s->get_impact(
+                        j, impact::impactIndices::launchAngle) =
+                        precision * j + minA;
+                }
+            }
+        }
+        std::array<Real, vSize * 3> velocitiesTime{};
+        multiTraj<AddTraj, Numerical, Hybrid, true>(ranges, nRanges,
+                                                    velocitiesTime, visitor);
+        for (std::size_t r = 0; r < nRanges; ++r) {
+            shell &s = *ranges[r].s;
+            for (std::size_t i = ranges[r].begin; i < ranges[r].end;
+                 i += vSize) {
+                std::copy_n(s.get_impactPtr(i, parkedV_x), vSize,
+                            &velocitiesTime[0]);
+                std::copy_n(s.get_impactPtr(i, parkedV_y), vSize,
+                            &velocitiesTime[vSize]);
+                std::copy_n(s.get_impactPtr(i, parkedTime), vSize,
+                            &velocitiesTime[vSize * 2]);
+                columns(i, s, velocitiesTime);
+            }
+        }
+    }
+
+    // Impact columns in Mask derived from the final velocities and time of
+    // rows [i, i + vSize) - intermediates only the skipped columns need
+    // aren't computed
+    template <bool nonAP, impact::columnMask Mask = impact::allColumns>
+    void impactColumns(const std::size_t i, shell &s,
+                       const std::array<Real, vSize * 3> &velocitiesTime)
+        const {
+        using indices = impact::impactIndices;
+        constexpr auto wants = [](const indices index) {
+            return impact::hasColumn(Mask, index);
+        };
+        constexpr bool penetration =
+            wants(indices::rawPenetration) ||
+            wants(indices::effectivePenetrationHorizontal) ||
+            wants(indices::effectivePenetrationDeck) ||
+            wants(indices::effectivePenetrationHorizontalNormalized) ||
+            wants(indices::effectivePenetrationDeckNormalized);
+        constexpr bool krupp = penetration && !nonAP;
+        constexpr bool angles = wants(indices::impactAngleHorizontalRadians) ||
+                                wants(indices::impactAngleHorizontalDegrees) ||
+                                wants(indices::impactAngleDeckDegrees) ||
+                                krupp;
+        constexpr bool speed = wants(indices::impactVelocity) || krupp;
+
+#if WOWS_SHELL_INSTRSET >= 6
+        const VT v_x = VT().load(&velocitiesTime[0]),
+                 v_y = VT().load(&velocitiesTime[vSize]),
+                 time = VT().load(&velocitiesTime[vSize * 2]);
+        VT IA_R, IAD_R, IV;
+        if constexpr (angles) {
+            IA_R = atan(v_y / v_x);
+            if constexpr (wants(indices::impactAngleHorizontalRadians)) {
+                IA_R.store(s.get_impactPtr(
+                    i, indices::impactAngleHorizontalRadians));
+            }
+            IAD_R = VT(M_PI_2) + IA_R;
+            const VT IA_D = IA_R * VT(180 / M_PI);
+            if constexpr (wants(indices::impactAngleHorizontalDegrees)) {
+                (IA_D * VT(-1))
+                    .store(s.get_impactPtr(
+                        i, indices::impactAngleHorizontalDegrees));
+            }
+            if constexpr (wants(indices::impactAngleDeckDegrees)) {
+                (VT(90) + IA_D)
+                    .store(s.get_impactPtr(i, indices::impactAngleDeckDegrees));
+            }
+        }
+
+        if constexpr (speed) {
+            IV = sqrt(v_x * v_x + v_y * v_y);
+            if constexpr (wants(indices::impactVelocity)) {
+                IV.store(s.get_impactPtr(i, indices::impactVelocity));
+            }
+        }
+
+        if constexpr (wants(indices::timeToTarget)) {
+            time.store(s.get_impactPtr(i, indices::timeToTarget));
+        }
+        if constexpr (wants(indices::timeToTargetAdjusted)) {
+            (time / VT(timeMultiplier))
+                .store(s.get_impactPtr(i, indices::timeToTargetAdjusted));
+        }
+
+        if constexpr (penetration) {
+            penetrationColumns<nonAP, Mask>(i, s, IA_R, IAD_R, IV);
+        }
+#else
+        for (uint32_t j = 0; j < vSize; j++) {
+            const Real &v_x = velocitiesTime[j],
+                         &v_y = velocitiesTime[j + vSize];
+            Real IA_R = 0, IAD_R = 0, IV = 0;
+            if constexpr (angles) {
+                IA_R = atan(v_y / v_x);
+                if constexpr (wants(indices::impactAngleHorizontalRadians)) {
+                    s.get_impact(i + j, indices::impactAngleHorizontalRadians) =
+                        IA_R;
+                }
+                IAD_R = M_PI_2 + IA_R;
+                const Real IA_D = IA_R * 180 / M_PI;
+                if constexpr (wants(indices::impactAngleHorizontalDegrees)) {
+                    s.get_impact(i + j, indices::impactAngleHorizontalDegrees) =
+                        IA_D * -1;
+                }
+                if constexpr (wants(indices::impactAngleDeckDegrees)) {
+                    s.get_impact(i + j, indices::impactAngleDeckDegrees) =
+                        90 + IA_D;
+                }
+            }
+
+            if constexpr (speed) {
+                IV = sqrt(v_x * v_x + v_y * v_y);
+                if constexpr (wants(indices::impactVelocity)) {
+                    s.get_impact(i + j, indices::impactVelocity) = IV;
+                }
+            }
+
+            const Real time = velocitiesTime[j + 2 * vSize];
+            if constexpr (wants(indices::timeToTarget)) {
+                s.get_impact(i + j, indices::timeToTarget) = time;
+            }
+            if constexpr (wants(indices::timeToTargetAdjusted)) {
+                s.get_impact(i + j, indices::timeToTargetAdjusted) =
+                    time / timeMultiplier;
+            }
+
+            if constexpr (penetration) {
+                penetrationColumns<nonAP, Mask>(i + j, s, IA_R, IAD_R, IV);
+            }
+        }
+#endif
+    }
+
+    // Penetration columns in Mask from the impact angle and velocity of row
+    // (vector of rows) i
+    template <bool nonAP, impact::columnMask Mask, typename V>
+    void penetrationColumns(const std::size_t i, shell &s, const V &IA_R,
+                            const V &IAD_R, const V &IV) const {
+        using indices = impact::impactIndices;
+        constexpr auto wants = [](const indices index) {
+            return impact::hasColumn(Mask, index);
+        };
+        constexpr bool scalar = std::is_same_v<V, Real>;
+        const auto store = [&](const indices index, const V &value) {
+            if constexpr (scalar) {
+                s.get_impact(i, index) = value;
+            } else {
+                value.store(s.get_impactPtr(i, index));
+            }
+        };
+        const auto storeWanted = [&](const indices index, const V &value) {
+            if (wants(index)) store(index, value);
+        };
+        if constexpr (nonAP) {
+            const V nonAPPen = V(s.nonAP);
+            storeWanted(indices::rawPenetration, nonAPPen);
+            storeWanted(indices::effectivePenetrationHorizontal, nonAPPen);
+            storeWanted(indices::effectivePenetrationDeck, nonAPPen);
+            storeWanted(indices::effectivePenetrationHorizontalNormalized,
+                        nonAPPen);
+            storeWanted(indices::effectivePenetrationDeckNormalized, nonAPPen);
+        } else {
+            const Real pPPC = s.get_pPPC();
+            const Real normalizationR = s.get_normalizationR();
+            V rawPenetration;
+            if constexpr (scalar) {
+                rawPenetration = pPPC * pow(IV, velocityPower);
+            } else {
+                rawPenetration = V(pPPC) * pow(IV, V(velocityPower));
+            }
+            storeWanted(indices::rawPenetration, rawPenetration);
+            constexpr bool horizontalNormalized =
+                wants(indices::effectivePenetrationHorizontalNormalized);
+            constexpr bool deckNormalized =
+                wants(indices::effectivePenetrationDeckNormalized);
+            if constexpr (wants(indices::effectivePenetrationHorizontal)) {
+                store(indices::effectivePenetrationHorizontal,
+                      rawPenetration * cos(IA_R));
+            }
+            if constexpr (wants(indices::effectivePenetrationDeck)) {
+                store(indices::effectivePenetrationDeck,
+                      rawPenetration * cos(IAD_R));
+            }
+            if constexpr (horizontalNormalized) {
+                store(indices::effectivePenetrationHorizontalNormalized,
+                      rawPenetration *
+                          cos(calcNormalizationR(IA_R, normalizationR)));
+            }
+            if constexpr (deckNormalized) {
+                store(indices::effectivePenetrationDeckNormalized,
+                      rawPenetration *
+                          cos(calcNormalizationR(IAD_R, normalizationR)));
+            }
+        }
+    }
+
+    // Redoes the penetration columns in Mask from the stored impact angles
+    // and velocities - all that changes with krupp, normalization or nonAP
+    template <impact::columnMask Mask>
+    void updatePenetration(shell &s, const std::size_t nThreads) const {
+        if (s.enableNonAP) {
+            updatePenetration<true, Mask>(s, nThreads);
+        } else {
+            updatePenetration<false, Mask>(s, nThreads);
+        }
+    }
+
+    template <bool nonAP, impact::columnMask Mask>
+    void updatePenetration(shell &s, const std::size_t nThreads) const {
+        using indices = impact::impactIndices;
+        const std::size_t length = static_cast<std::size_t>(
+            ceil(static_cast<double>(s.impactSize) / vSize));
+        const std::size_t assigned = assignThreadNum(length, nThreads);
+        mtFunctionRunner(
+            assigned, length, [&](const std::size_t i) {
+#if WOWS_SHELL_INSTRSET >= 6
+                const VT IA_R = VT().load(s.get_impactPtr(
+                             i, indices::impactAngleHorizontalRadians)),
+                         IV = VT().load(
+                             s.get_impactPtr(i, indices::impactVelocity));
+                penetrationColumns<nonAP, Mask>(i, s, IA_R,
+                                                VT(M_PI_2) + IA_R, IV);
+#else
+                for (uint32_t j = 0; j < vSize; j++) {
+                    const Real IA_R = s.get_impact(
+                        i + j, indices::impactAngleHorizontalRadians);
+                    const Real IAD_R = M_PI_2 + IA_R;
+                    penetrationColumns<nonAP, Mask>(
+                        i + j, s, IA_R, IAD_R,
+                        s.get_impact(i + j, indices::impactVelocity));
+                }
+#endif
+            });
+    }
+
+    // Whether the penetration columns in mask can be redone from the impact
+    // angles and velocities kept alongside
+    static constexpr bool rederivable(const impact::columnMask mask) {
+        using indices = impact::impactIndices;
+        return impact::hasColumn(mask, indices::impactAngleHorizontalRadians) &&
+               impact::hasColumn(mask, indices::impactVelocity);
+    }
+
+    // Whether only the penetration columns of the impact data are out of
+    // date for key - same settings and trajectory parameters, and the
+    // angles and velocities they derive from were kept
+    bool penetrationOnly(const shell &s, const std::string &key,
+                         const impact::columnMask mask) const {
+        using parameters::group, parameters::groups;
+        if (!s.completedImpact ||
+            (s.changedParameters & group(groups::trajectory)) ||
+            s.impactSignature.size() != key.size() || !rederivable(mask))
+            return false;
+        // Past the "i" and the shell hash, the key holds the settings
+        const std::size_t settings = 1 + generateHash(s).size();
+        return s.impactSignature.compare(settings, std::string::npos, key,
+                                         settings, std::string::npos) == 0;
+    }
+
+   public:
+    std::size_t calculateAlignmentSize(
+        std::size_t unalignedSize) const noexcept {
+        // leave extra space to allow for copies into the region
+        // ex: | 0, 1, 2, 3, 4, 5 | -> | 0, 1, 2, 3, 4, 5 |, 0, 1, 2 + padding
+        // allows for easier vectorization of code that uses this data
+        std::size_t processedSize = unalignedSize;
+        if (processedSize % vSize != 0) {
+            processedSize += vSize - 1;
+        }
+        // Templates to reduce branching
+        return vSize - (processedSize % vSize) + processedSize;
+    }
+    // Templates to reduce branching
+    template <auto Numerical, bool Hybrid>
+    void calculateImpact(
+        shell &s, bool addTraj,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        if (addTraj) {
+            calculateImpact<true, Numerical, Hybrid>(s, nThreads);
+        } else {
+            calculateImpact<false, Numerical, Hybrid>(s, nThreads);
+        }
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void calculateImpact(
+        shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        if (s.enableNonAP) {
+            calculateImpact<AddTraj, Numerical, Hybrid, true>(s, nThreads);
+        } else {
+            calculateImpact<AddTraj, Numerical, Hybrid, false>(s, nThreads);
+        }
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid, bool nonAP>
+    void calculateImpact(
+        shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        cachedImpact<AddTraj, Numerical, Hybrid, nonAP>(s, nThreads);
+    }
+
+    // Only the impact columns in Mask - built with impact::columns(...) -
+    // are computed, besides distance and launchAngle. impactData keeps the
+    // columns up to the highest one needed. Angles, dispersion and
+    // post-penetration need every column and recompute the impact data
+    // otherwise.
+    template <impact::columnMask Mask, bool AddTraj, auto Numerical,
+              bool Hybrid>
+    void calculateImpactColumns(
+        shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        if (s.enableNonAP) {
+            cachedImpact<AddTraj, Numerical, Hybrid, true, Mask>(s, nThreads);
+        } else {
+            cachedImpact<AddTraj, Numerical, Hybrid, false, Mask>(s, nThreads);
+        }
+    }
+
+    // visitor(const stepState &) is called after every integration step of
+    // every vector group - from several threads at once, though never for
+    // the same row - so derived quantities such as apex height can be taken
+    // without recording trajectories. The steps are always run: the cache
+    // is only written to.
+    template <bool AddTraj, auto Numerical, bool Hybrid, typename Visitor,
+              typename = std::enable_if_t<
+                  std::is_invocable_v<Visitor &, const stepState &>>>
+    void calculateImpact(
+        shell &s, Visitor &&visitor,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        std::string key = impactKey<AddTraj, Numerical, Hybrid>(s);
+        if (s.enableNonAP) {
+            runImpact<AddTraj, Numerical, Hybrid, true>(s, std::move(key),
+                                                        nThreads, visitor);
+        } else {
+            runImpact<AddTraj, Numerical, Hybrid, false>(s, std::move(key),
+                                                         nThreads, visitor);
+        }
+    }
+
+    // calculateImpact, calculateAngles and calculateDispersion in one pass:
+    // each vector group's angle and dispersion columns are computed right
+    // after its impact columns, while they are still in cache, with a single
+    // dispatch to the thread pool. Impact data that is cached or can be
+    // derived without integrating falls back to the separate steps.
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void calculateImpactAnglesDispersion(
+        shell &s, const double thickness, const double inclination,
+        const dispersion::verticalTypes verticalType,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        if (s.enableNonAP) {
+            fusedImpact<AddTraj, Numerical, Hybrid, true>(
+                s, thickness, inclination, verticalType, nThreads);
+        } else {
+            fusedImpact<AddTraj, Numerical, Hybrid, false>(
+                s, thickness, inclination, verticalType, nThreads);
+        }
+    }
+
+    // Every shell in [first, last) - vector groups of the whole fleet are
+    // handed out together so that small shells don't each pay for waking
+    // the thread pool. With laneRefill a landed lane is refilled from the
+    // next row of the fleet, packing rows of different shells into one
+    // vector.
+    template <bool AddTraj, auto Numerical, bool Hybrid, typename ShellIt>
+    void calculateImpact(
+        ShellIt first, ShellIt last,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        std::vector<shell *> fleet;
+        std::vector<std::string> keys, ballisticKeys;
+        // First vector group of each shell - the fleet's groups end to end
+        std::vector<std::size_t> groups{0};
+        // Shells flying the same trajectories as one computed in this call
+        std::unordered_map<std::string, std::size_t> computed;
+        std::vector<std::tuple<shell *, std::size_t, std::string>> sharing;
+        for (; first != last; ++first) {
+            shell &s = *first;
+            std::string key = impactKey<AddTraj, Numerical, Hybrid>(s);
+            if (const auto cached = cacheLookup(key)) {
+                restoreImpact<AddTraj>(*cached, s);
+                completeImpact<AddTraj, Numerical, Hybrid>(s, std::move(key),
+                                                           impact::allColumns);
+                continue;
+            }
+            if (penetrationOnly(s, key, impact::allColumns)) {
+                updatePenetration<impact::allColumns>(s, nThreads);
+                storeImpact<AddTraj>(key, s);
+                completeImpact<AddTraj, Numerical, Hybrid>(s, std::move(key),
+                                                           impact::allColumns);
+                continue;
+            }
+            std::string ballistic = ballisticKey<AddTraj, Numerical, Hybrid>(s);
+            if (const auto it = computed.find(ballistic);
+                it != computed.end()) {
+                sharing.emplace_back(&s, it->second, std::move(key));
+                continue;
+            }
+            if (const auto shared = cacheLookup(ballistic)) {
+                restoreImpact<AddTraj>(*shared, s);
+                updatePenetration<impact::allColumns>(s, nThreads);
+                storeImpact<AddTraj>(key, s);
+                completeImpact<AddTraj, Numerical, Hybrid>(s, std::move(key),
+                                                           impact::allColumns);
+                continue;
+            }
+            computed.emplace(ballistic, fleet.size());
+            prepareImpact<AddTraj>(s);
+            fleet.push_back(&s);
+            keys.push_back(std::move(key));
+            ballisticKeys.push_back(std::move(ballistic));
+            groups.push_back(groups.back() +
+                             (s.impactSize + vSize - 1) / vSize);
+        }
+        if (nThreads > std::thread::hardware_concurrency()) {
+            nThreads = std::thread::hardware_concurrency();
+        }
+        const std::size_t totalGroups = groups.back();
+        // Shell holding group g - empty shells own no groups
+        const auto shellOf = [&](const std::size_t g) -> std::size_t {
+            return std::upper_bound(groups.begin(), groups.end(), g) -
+                   groups.begin() - 1;
+        };
+        const auto columns = [&](const std::size_t i, shell &s,
+                                 const std::array<Real, vSize * 3> &vt) {
+            if (s.enableNonAP) {
+                impactColumns<true>(i, s, vt);
+            } else {
+                impactColumns<false>(i, s, vt);
+            }
+        };
+
+        bool refilled = false;
+        if constexpr (!isMultistep<Numerical>()) {
+            if (laneRefill) {
+                refilled = true;
+                std::size_t length =
+                    ceil(static_cast<double>(totalGroups) / refillGroups);
+                std::size_t assigned = assignThreadNum(length, nThreads);
+                mtFunctionRunner(
+                    assigned, length, [&](const std::size_t i) {
+                        // i is in units of vSize
+                        const std::size_t begin = i / vSize * refillGroups,
+                                          end = std::min(begin + refillGroups,
+                                                         totalGroups);
+                        std::array<rowRange, refillGroups> ranges{};
+                        std::size_t nRanges = 0;
+                        for (std::size_t g = begin; g < end;) {
+                            const std::size_t j = shellOf(g);
+                            const std::size_t stop =
+                                std::min(end, groups[j + 1]);
+                            ranges[nRanges++] = {
+                                fleet[j], (g - groups[j]) * vSize,
+                                std::min((stop - groups[j]) * vSize,
+                                         fleet[j]->impactSize)};
+                            g = stop;
+                        }
+                        impactRefill<AddTraj, Numerical, Hybrid, false>(
+                            ranges.data(), nRanges, columns);
+                    });
+            }
+        }
+        if (!refilled) {
+            std::size_t assigned = assignThreadNum(totalGroups, nThreads);
+            mtFunctionRunner(
+                assigned, totalGroups, [&](const std::size_t i) {
+                    const std::size_t g = i / vSize, j = shellOf(g);
+                    shell &s = *fleet[j];
+                    const std::size_t row = (g - groups[j]) * vSize;
+                    if (s.enableNonAP) {
+                        impactGroup<AddTraj, Numerical, Hybrid, false, true>(
+                            row, s);
+                    } else {
+                        impactGroup<AddTraj, Numerical, Hybrid, false, false>(
+                            row, s);
+                    }
+                });
+        }
+        for (std::size_t j = 0; j < fleet.size(); ++j) {
+            if constexpr (AddTraj) {
+                fleet[j]->trajectories.compact();
+            }
+            storeImpact<AddTraj>(keys[j], *fleet[j], ballisticKeys[j]);
+            completeImpact<AddTraj, Numerical, Hybrid>(
+                *fleet[j], std::move(keys[j]), impact::allColumns);
+        }
+        for (auto &[s, j, key] : sharing) {
+            shareImpact<AddTraj>(*fleet[j], *s);
+            updatePenetration<impact::allColumns>(*s, nThreads);
+            storeImpact<AddTraj>(key, *s);
+            completeImpact<AddTraj, Numerical, Hybrid>(*s, std::move(key),
+                                                       impact::allColumns);
+        }
+    }
+
+    template <auto Numerical>
+    void calculateFit(shell &s, std::size_t nThreads =
+                                    std::thread::hardware_concurrency()) const {
+        impactRunner<false, Numerical, false, true, false, impact::fitColumns>(
+            s, nThreads);
+        recordImpactSettings<false, Numerical, false>(s);
+        s.impactSignature.clear();
+        s.impactMask = impact::fitColumns;
+        s.changedParameters = 0;
+    }
+
+    // Impact data at exactly the given distances - the launch angle of each
+    // within [minA, maxA] is solved for instead of sweeping every precision
+    // step. Rows that can't be reached within [minA, maxA] are NaN. The
+    // water line crossing is always located exactly, otherwise distances
+    // would jump by a time step between neighbouring angles.
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void calculateImpactDistances(
+        shell &s, const std::vector<double> &distances,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        // Solved angles never exceed maxA
+        prepareImpact<AddTraj>(s, distances.size(),
+                               [&](const std::size_t) { return maxA; });
+        if (nThreads > std::thread::hardware_concurrency()) {
+            nThreads = std::thread::hardware_concurrency();
+        }
+        constexpr std::size_t chunk = vSize * refillGroups;
+        std::size_t length = ceil(static_cast<double>(s.impactSize) / chunk);
+        std::size_t assigned = assignThreadNum(length, nThreads);
+        mtFunctionRunner(
+            assigned, length, [&](const std::size_t i) {
+                // i is in units of vSize
+                const std::size_t begin = i * refillGroups;
+                solveDistances<AddTraj, Numerical, Hybrid>(
+                    begin, std::min(begin + chunk, s.impactSize), s,
+                    distances);
+            });
+        if constexpr (AddTraj) {
+            s.trajectories.compact();
+        }
+        recordImpactSettings<AddTraj, Numerical, Hybrid>(s);
+        s.impactSignature.clear();
+        s.impactMask = impact::allColumns;
+        s.changedParameters = 0;
+        s.completedImpact = true;
+    }
+
+   private:
+    // Safeguarded secant iteration on the launch angle of rows [begin, end)
+    // - every iteration runs all unsolved rows through the lanes together.
+    // Steps leaving the bracket of evaluated angles fall back to bisection;
+    // minA and maxA are only evaluated if the iteration heads past them.
+    template <bool AddTraj, numerical Numerical, bool Hybrid>
+    void solveDistances(const std::size_t begin, const std::size_t end,
+                        shell &s, const std::vector<double> &distances) const {
+        constexpr std::size_t chunk = vSize * refillGroups;
+        constexpr std::size_t maxIterations = 64;
+        // Multistep lanes can't be refilled
+        constexpr std::size_t batch = isMultistep<Numerical>() ? vSize : chunk;
+        enum class solveStatus { pending, solved, unreachable };
+        std::array<solveStatus, chunk> status;
+        std::array<double, chunk> angle, previous, previousError, lo, hi;
+        std::array<bool, chunk> loKnown{}, hiKnown{};
+        const std::size_t n = end - begin;
+
+        for (std::size_t j = 0; j < n; ++j) {
+            // Vacuum trajectory - drag only ever shortens it. Shells landing
+            // within their first time step don't resolve distance.
+            const double target = distances[begin + j],
+                         reach = g * target / (s.get_v0() * s.get_v0());
+            status[j] = reach > 1 || target <= s.get_v0() * dt_min
+                            ? solveStatus::unreachable
+                            : solveStatus::pending;
+            angle[j] = std::min(std::max(asin(reach) / 2 * 180 / M_PI, minA),
+                                maxA);
+            previous[j] = std::numeric_limits<double>::quiet_NaN();
+            lo[j] = minA, hi[j] = maxA;
+        }
+
+        std::vector<rowRange> ranges;
+        ranges.reserve(n);
+        std::array<Real, vSize * 3> velocitiesTime{};
+        for (std::size_t iteration = 0; iteration < maxIterations;
+             ++iteration) {
+            ranges.clear();
+            for (std::size_t j = 0; j < n; ++j) {
+                if (status[j] != solveStatus::pending) continue;
+                s.get_impact(begin + j, impact::impactIndices::launchAngle) =
+                    angle[j];
+                ranges.push_back({&s, begin + j, begin + j + 1});
+            }
+            if (ranges.empty()) break;
+            for (std::size_t r = 0; r < ranges.size(); r += batch) {
+                multiTraj<AddTraj, Numerical, Hybrid, true, true>(
+                    &ranges[r], std::min(batch, ranges.size() - r),
+                    velocitiesTime);
+            }
+
+            for (std::size_t j = 0; j < n; ++j) {
+                if (status[j] != solveStatus::pending) continue;
+                const double target = distances[begin + j];
+                const double error =
+                    s.get_impact(begin + j, impact::impactIndices::distance) -
+                    target;
+                if (fabs(error) <= solveTolerance) {
+                    status[j] = solveStatus::solved;
+                    continue;
+                }
+                // Past the bounds of the angle range
+                if ((error < 0 && angle[j] >= maxA) ||
+                    (error > 0 && angle[j] <= minA)) {
+                    status[j] = solveStatus::unreachable;
+                    continue;
+                }
+                if (error < 0) {
+                    lo[j] = angle[j], loKnown[j] = true;
+                } else {
+                    hi[j] = angle[j], hiKnown[j] = true;
+                }
+
+                double next;
+                if (std::isnan(previous[j])) {
+                    // Distance grows roughly in proportion to the angle
+                    next = angle[j] * target / (error + target);
+                } else {
+                    next = angle[j] - error * (angle[j] - previous[j]) /
+                                          (error - previousError[j]);
+                }
+                previous[j] = angle[j], previousError[j] = error;
+                if (!(next > lo[j] && next < hi[j])) {
+                    if (next >= hi[j] && !hiKnown[j]) {
+                        next = maxA;
+                    } else if (next <= lo[j] && !loKnown[j]) {
+                        next = minA;
+                    } else {
+                        next = (lo[j] + hi[j]) / 2;
+                    }
+                }
+                if (next == angle[j]) {
+                    // Bracketed to within rounding - otherwise a plateau
+                    status[j] = loKnown[j] && hiKnown[j]
+                                    ? solveStatus::solved
+                                    : solveStatus::unreachable;
+                    continue;
                 }
+                angle[j] = next;
             }
         }
 
-        auto distanceTarget =
-            s.get_impactPtr(start, impact::impactIndices::distance);
-#if defined(__SSE4_1__) || defined(__AVX__)
-        v_xR.store(&velocities[vSize * 0]);
-        v_yR.store(&velocities[vSize * 1]);
-        tR.store(&velocities[vSize * 2]);
-        xR.store(distanceTarget);
-#else
-        std::copy_n(xy.begin(), vSize, distanceTarget);
-#endif
-    }
-
-    // Several trajectories done in one chunk to allow for vectorization
-    template <bool AddTraj, numerical Numerical, bool Fit, bool nonAP>
-    void impactGroup(const std::size_t i, shell &s) const {
-        const double pPPC = s.get_pPPC();
-        const double normalizationR = s.get_normalizationR();
-        // std::cout<<"Entered\n";
-        std::array<double, vSize * 3> velocitiesTime{};
-// 0 -> (v_x) -> vSize -> (v_y) -> 2*vSize -> (t) -> 3*vSize
-#ifdef __AVX2__
-        static_assert(vSize == 4, "AVX2 Requires vSize of 4");
-        VT indices = {0, 1, 2, 3};
-#elif defined(__SSE4_2__) || defined(__AVX__)
-        static_assert(vSize == 2, " Requires vSize of 2");
-        VT indices = {0, 1};
-#endif
-
-#if defined(__SSE4_2__) || defined(__AVX__)
-        VT launch_degrees, launch_radians, v0_v, v_xv, v_yv;
-        if constexpr (!Fit) {
-            launch_degrees = VT(precision) * (VT(i) + indices) + VT(minA);
-            launch_degrees.store(
-                s.get_impactPtr(i, impact::impactIndices::launchAngle));
-        } else {
-            launch_degrees.load(
-                s.get_impactPtr(i, impact::impactIndices::launchAngle));
+        for (std::size_t j = 0; j < n; ++j) {
+            if (status[j] == solveStatus::pending) {
+                status[j] = solveStatus::unreachable;
+            }
         }
-        launch_radians = launch_degrees * VT(M_PI / 180);
-        v0_v = VT(s.get_v0());
-        VT cx, cy;
-        cy = sincos(&cx, launch_radians);
-        v_xv = cx * v0_v, v_yv = cy * v0_v;
-        v_xv.store(&velocitiesTime[0]);
-        v_yv.store(&velocitiesTime[vSize]);
-#else
-        for (uint32_t j = 0; j < vSize; j++) {
-            double radianLaunch;
-            if constexpr (!Fit) {
-                double degreeLaunch = precision * (i + j) + minA;
-                s.get_impact(i + j, impact::impactIndices::launchAngle) =
-                    degreeLaunch;
-                radianLaunch = degreeLaunch * M_PI / 180;
+        for (std::size_t i = begin; i < end; i += vSize) {
+            std::copy_n(s.get_impactPtr(i, parkedV_x), vSize,
+                        &velocitiesTime[0]);
+            std::copy_n(s.get_impactPtr(i, parkedV_y), vSize,
+                        &velocitiesTime[vSize]);
+            std::copy_n(s.get_impactPtr(i, parkedTime), vSize,
+                        &velocitiesTime[vSize * 2]);
+            if (s.enableNonAP) {
+                impactColumns<true>(i, s, velocitiesTime);
             } else {
-                radianLaunch =
-                    s.get_impact(i + j, impact::impactIndices::launchAngle) *
-                    M_PI / 180;
+                impactColumns<false>(i, s, velocitiesTime);
             }
-            velocitiesTime[j] = s.get_v0() * cos(radianLaunch);
-            velocitiesTime[j + vSize] = s.get_v0() * sin(radianLaunch);
         }
-#endif
-        // std::cout<<"Calculating\n";
-        multiTraj<AddTraj, Numerical>(i, s, velocitiesTime);
-// std::cout<<"Processing\n";
-#if defined(__SSE4_2__) || defined(__AVX__)
-        const VT v_x = VT().load(&velocitiesTime[0]),
-                 v_y = VT().load(&velocitiesTime[vSize]),
-                 time = VT().load(&velocitiesTime[vSize * 2]);
-        const VT IA_R = atan(v_y / v_x);
-        IA_R.store(s.get_impactPtr(
-            i, impact::impactIndices::impactAngleHorizontalRadians));
+        for (std::size_t j = 0; j < n; ++j) {
+            if (status[j] != solveStatus::unreachable) continue;
+            for (std::size_t c = 0; c < impact::maxColumns; ++c) {
+                s.get_impact(begin + j, c) =
+                    std::numeric_limits<Real>::quiet_NaN();
+            }
+            if constexpr (AddTraj) {
+                s.trajectories.clear(begin + j);
+            }
+        }
+    }
 
-        const VT IAD_R = VT(M_PI_2) + IA_R;
-        const VT IA_D = IA_R * VT(180 / M_PI);
-        (IA_D * VT(-1))
-            .store(s.get_impactPtr(
-                i, impact::impactIndices::impactAngleHorizontalDegrees));
-        (VT(90) + IA_D)
-            .store(s.get_impactPtr(
-                i, impact::impactIndices::impactAngleDeckDegrees));
+    // Cache keys - the raw bytes of every setting and argument a result
+    // depends on
+    template <typename... Args>
+    static void appendKey(std::string &key, const Args... args) {
+        (key.append(reinterpret_cast<const char *>(&args), sizeof(Args)), ...);
+    }
 
-        const VT IV = sqrt(v_x * v_x + v_y * v_y);
-        IV.store(s.get_impactPtr(i, impact::impactIndices::impactVelocity));
+    template <bool AddTraj, auto Numerical, bool Hybrid,
+              impact::columnMask Mask>
+    void appendSettings(std::string &key) const {
+        appendKey(key, Atmosphere, Numerical, AddTraj, Hybrid, Mask, maxA, minA,
+                  precision, x0, y0, dt_min, tolerance, exactImpact,
+                  hybridHeight, hybridScale, recordMode, recordStride,
+                  recordSpacing, recordTolerance);
+    }
 
-        time.store(s.get_impactPtr(i, impact::impactIndices::timeToTarget));
-        (time / VT(timeMultiplier))
-            .store(s.get_impactPtr(
-                i, impact::impactIndices::timeToTargetAdjusted));
+    template <bool AddTraj, auto Numerical, bool Hybrid,
+              impact::columnMask Mask = impact::allColumns>
+    std::string impactKey(const shell &s) const {
+        std::string key = "i" + generateHash(s);
+        appendSettings<AddTraj, Numerical, Hybrid, Mask>(key);
+        return key;
+    }
 
-        if constexpr (!Fit) {
-            if constexpr (nonAP) {
-                const VT nonAPPen = VT(s.nonAP);
-                nonAPPen.store(
-                    s.get_impactPtr(i, impact::impactIndices::rawPenetration));
-                nonAPPen.store(s.get_impactPtr(
-                    i, impact::impactIndices::effectivePenetrationHorizontal));
-                nonAPPen.store(s.get_impactPtr(
-                    i, impact::impactIndices::effectivePenetrationDeck));
-                nonAPPen.store(s.get_impactPtr(
-                    i, impact::impactIndices::
-                           effectivePenetrationHorizontalNormalized));
-                nonAPPen.store(s.get_impactPtr(
-                    i,
-                    impact::impactIndices::effectivePenetrationDeckNormalized));
-            } else {
-                const VT rawPenetration = VT(pPPC) * pow(IV, VT(velocityPower));
-                rawPenetration.store(
-                    s.get_impactPtr(i, impact::impactIndices::rawPenetration));
+    // Shells with the same drag and muzzle velocity fly the same
+    // trajectories - only their penetration columns differ. Empty if those
+    // can't be redone from the columns in Mask.
+    template <bool AddTraj, auto Numerical, bool Hybrid,
+              impact::columnMask Mask = impact::allColumns>
+    std::string ballisticKey(const shell &s) const {
+        if (!rederivable(Mask)) return {};
+        std::string key = "b";
+        appendKey(key, s.k, s.cw_2, s.v0);
+        appendSettings<AddTraj, Numerical, Hybrid, Mask>(key);
+        return key;
+    }
 
-                (rawPenetration * cos(IA_R))
-                    .store(s.get_impactPtr(
-                        i,
-                        impact::impactIndices::effectivePenetrationHorizontal));
-                (rawPenetration * cos(IAD_R))
-                    .store(s.get_impactPtr(
-                        i, impact::impactIndices::effectivePenetrationDeck));
-                (rawPenetration * cos(calcNormalizationR(IA_R, normalizationR)))
-                    .store(s.get_impactPtr(
-                        i, impact::impactIndices::
-                               effectivePenetrationHorizontalNormalized));
-                (rawPenetration *
-                 cos(calcNormalizationR(IAD_R, normalizationR)))
-                    .store(s.get_impactPtr(
-                        i, impact::impactIndices::
-                               effectivePenetrationDeckNormalized));
-            }
-        }
-#else
-        for (uint32_t j = 0; j < vSize; j++) {
-            const double &v_x = velocitiesTime[j],
-                         &v_y = velocitiesTime[j + vSize];
-            const double IA_R = atan(v_y / v_x);
-
-            s.get_impact(i + j,
-                         impact::impactIndices::impactAngleHorizontalRadians) =
-                IA_R;
-            const double IAD_R = M_PI_2 + IA_R;
-            const double IA_D = IA_R * 180 / M_PI;
-            s.get_impact(i + j,
-                         impact::impactIndices::impactAngleHorizontalDegrees) =
-                IA_D * -1;
-            s.get_impact(i + j, impact::impactIndices::impactAngleDeckDegrees) =
-                90 + IA_D;
-
-            const double IV = sqrt(v_x * v_x + v_y * v_y);
-            s.get_impact(i + j, impact::impactIndices::impactVelocity) = IV;
-
-            const double time = velocitiesTime[j + 2 * vSize];
-            s.get_impact(i + j, impact::impactIndices::timeToTarget) = time;
-            s.get_impact(i + j, impact::impactIndices::timeToTargetAdjusted) =
-                time / timeMultiplier;
+    // Results computed from the impact data - empty if its origin is unknown
+    template <typename... Args>
+    std::string derivedKey(const char kind, const shell &s,
+                           const Args... args) const {
+        if (s.impactSignature.empty()) return {};
+        std::string key(1, kind);
+        key += generateHash(s);
+        key += s.impactSignature;
+        appendKey(key, args...);
+        return key;
+    }
 
-            if constexpr (!Fit) {
-                if constexpr (nonAP) {
-                    s.get_impact(i + j, impact::impactIndices::rawPenetration) =
-                        s.nonAP;
-                    s.get_impact(
-                        i + j,
-                        impact::impactIndices::effectivePenetrationHorizontal) =
-                        s.nonAP;
-                    s.get_impact(
-                        i + j,
-                        impact::impactIndices::effectivePenetrationDeck) =
-                        s.nonAP;
-                    s.get_impact(i + j,
-                                 impact::impactIndices::
-                                     effectivePenetrationHorizontalNormalized) =
-                        s.nonAP;
-                    s.get_impact(i + j,
-                                 impact::impactIndices::
-                                     effectivePenetrationDeckNormalized) =
-                        s.nonAP;
-                } else {
-                    const double rawPenetration = pPPC * pow(IV, velocityPower);
-                    s.get_impact(i + j, impact::impactIndices::rawPenetration) =
-                        rawPenetration;
-
-                    s.get_impact(
-                        i + j,
-                        impact::impactIndices::effectivePenetrationHorizontal) =
-                        rawPenetration * cos(IA_R);
-                    s.get_impact(
-                        i + j,
-                        impact::impactIndices::effectivePenetrationDeck) =
-                        rawPenetration * cos(IAD_R);
-
-                    s.get_impact(i + j,
-                                 impact::impactIndices::
-                                     effectivePenetrationHorizontalNormalized) =
-                        rawPenetration *
-                        cos(calcNormalizationR(IA_R, normalizationR));
-                    s.get_impact(i + j,
-                                 impact::impactIndices::
-                                     effectivePenetrationDeckNormalized) =
-                        rawPenetration *
-                        cos(calcNormalizationR(IAD_R, normalizationR));
-                }
-            }
-        }
-#endif
+    std::shared_ptr<const cachedResult> cacheLookup(
+        const std::string &key) const {
+        if (key.empty()) return nullptr;
+        return cache.find(key);
     }
 
-   public:
-    std::size_t calculateAlignmentSize(
-        std::size_t unalignedSize) const noexcept {
-        // leave extra space to allow for copies into the region
-        // ex: | 0, 1, 2, 3, 4, 5 | -> | 0, 1, 2, 3, 4, 5 |, 0, 1, 2 + padding
-        // allows for easier vectorization of code that uses this data
-        std::size_t processedSize = unalignedSize;
-        if (processedSize % vSize != 0) {
-            processedSize += vSize - 1;
+    bool caching(const std::string &key) const {
+        return !key.empty() && cache.get_capacity() > 0;
+    }
+
+    void cacheStore(const std::string &key, cachedResult result) const {
+        cache.insert(key,
+                     std::make_shared<const cachedResult>(std::move(result)));
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    static void recordImpactSettings(shell &s) {
+        s.impactNumerical = Numerical;
+        s.impactHybrid = Hybrid;
+        s.impactAddTraj = AddTraj;
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    void completeImpact(shell &s, std::string key,
+                        const impact::columnMask mask) const {
+        recordImpactSettings<AddTraj, Numerical, Hybrid>(s);
+        s.impactSignature = std::move(key);
+        s.impactMask = mask | impact::trajectoryColumns;
+        s.changedParameters = 0;
+        s.completedImpact = true;
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid, bool nonAP,
+              impact::columnMask Mask = impact::allColumns>
+    void cachedImpact(shell &s, const std::size_t nThreads) const {
+        std::string key = impactKey<AddTraj, Numerical, Hybrid, Mask>(s);
+        if (!reuseImpact<AddTraj, Numerical, Hybrid, Mask>(s, key, nThreads)) {
+            runImpact<AddTraj, Numerical, Hybrid, nonAP, Mask>(
+                s, std::move(key), nThreads);
         }
-        // Templates to reduce branching
-        return vSize - (processedSize % vSize) + processedSize;
     }
-    // Templates to reduce branching
-    template <auto Numerical, bool Hybrid>
-    void calculateImpact(
-        shell &s, bool addTraj,
-        std::size_t nThreads = std::thread::hardware_concurrency()) const {
-        if (addTraj) {
-            calculateImpact<true, Numerical, Hybrid>(s, nThreads);
+
+    // Impact data for key without integrating - from the cache, by redoing
+    // the penetration columns or from a shell flying the same trajectories.
+    // False if it has to be computed.
+    template <bool AddTraj, auto Numerical, bool Hybrid,
+              impact::columnMask Mask>
+    bool reuseImpact(shell &s, std::string &key,
+                     const std::size_t nThreads) const {
+        if (const auto cached = cacheLookup(key)) {
+            restoreImpact<AddTraj>(*cached, s);
+        } else if (penetrationOnly(s, key, Mask)) {
+            updatePenetration<Mask>(s, nThreads);
+            storeImpact<AddTraj>(key, s);
+        } else if (const auto shared = cacheLookup(
+                       ballisticKey<AddTraj, Numerical, Hybrid, Mask>(s))) {
+            restoreImpact<AddTraj>(*shared, s);
+            updatePenetration<Mask>(s, nThreads);
+            storeImpact<AddTraj>(key, s);
         } else {
-            calculateImpact<false, Numerical, Hybrid>(s, nThreads);
+            return false;
         }
+        completeImpact<AddTraj, Numerical, Hybrid>(s, std::move(key), Mask);
+        return true;
     }
 
-    template <bool AddTraj, auto Numerical, bool Hybrid>
-    void calculateImpact(
-        shell &s,
-        std::size_t nThreads = std::thread::hardware_concurrency()) const {
-        if (s.enableNonAP) {
-            calculateImpact<true, Numerical, Hybrid, true>(s, nThreads);
-        } else {
-            calculateImpact<true, Numerical, Hybrid, false>(s, nThreads);
+    template <bool AddTraj, auto Numerical, bool Hybrid, bool nonAP,
+              impact::columnMask Mask = impact::allColumns,
+              typename Visitor = noVisitor>
+    void runImpact(shell &s, std::string key, const std::size_t nThreads,
+                   Visitor &visitor = unvisited) const {
+        prepareImpact<AddTraj, Mask>(s);
+        impactRunner<AddTraj, Numerical, Hybrid, false, nonAP, Mask>(
+            s, nThreads, visitor);
+        if constexpr (AddTraj) {
+            s.trajectories.compact();
         }
+        storeImpact<AddTraj>(key, s,
+                             ballisticKey<AddTraj, Numerical, Hybrid, Mask>(s));
+        completeImpact<AddTraj, Numerical, Hybrid>(s, std::move(key), Mask);
     }
 
     template <bool AddTraj, auto Numerical, bool Hybrid, bool nonAP>
-    void calculateImpact(
-        shell &s,
-        std::size_t nThreads = std::thread::hardware_concurrency()) const {
-        s.impactSize =
-            static_cast<std::size_t>(maxA / precision - minA / precision) + 1;
-        s.impactSizeAligned = calculateAlignmentSize(s.impactSize);
+    void fusedImpact(shell &s, const double thickness, const double inclination,
+                     const dispersion::verticalTypes verticalType,
+                     const std::size_t nThreads) const {
+        std::string key = impactKey<AddTraj, Numerical, Hybrid>(s);
+        if (reuseImpact<AddTraj, Numerical, Hybrid, impact::allColumns>(
+                s, key, nThreads)) {
+            calculateAngles(thickness, inclination, s, nThreads);
+            calculateDispersion(verticalType, s, nThreads);
+            return;
+        }
+        prepareImpact<AddTraj>(s);
+        s.angleData.resize(angle::maxColumns * s.impactSizeAligned);
+        s.dispersionData.resize(dispersion::maxColumns * s.impactSizeAligned);
+        const double inclination_R = inclination / 180 * M_PI;
+        const double fusingAngle = fusingAngleOf(thickness, s);
+        const anglesKernel angles = selectAngles(thickness, fusingAngle, s);
+        const dispersionKernel group = selectDispersion(verticalType, s);
+        impactRunner<AddTraj, Numerical, Hybrid, false, nonAP>(
+            s, nThreads, unvisited, [&](const std::size_t i, shell &target) {
+                (this->*angles)(i, thickness, inclination_R, fusingAngle,
+                                target);
+                (this->*group)(i, target);
+            });
         if constexpr (AddTraj) {
-            s.trajectories.resize(2 * s.impactSize);
+            s.trajectories.compact();
         }
-        s.impactData.resize(impact::maxColumns * s.impactSizeAligned);
+        storeImpact<AddTraj>(key, s,
+                             ballisticKey<AddTraj, Numerical, Hybrid>(s));
+        completeImpact<AddTraj, Numerical, Hybrid>(s, std::move(key),
+                                                   impact::allColumns);
+
+        const std::string anglesKey = angleKey(s, thickness, inclination);
+        if (caching(anglesKey)) {
+            cacheStore(anglesKey, {s.impactSize, 0, s.angleData});
+        }
+        const std::string dispersionsKey = dispersionKey(s, verticalType);
+        if (caching(dispersionsKey)) {
+            cacheStore(dispersionsKey, {s.impactSize, 0, s.dispersionData});
+        }
+        s.completedAngles = true;
+        s.completedDispersion = true;
+    }
 
-        if (nThreads > std::thread::hardware_concurrency()) {
-            nThreads = std::thread::hardware_concurrency();
+    template <bool AddTraj>
+    void restoreImpact(const cachedResult &cached, shell &s) const {
+        s.impactSize = cached.size;
+        s.impactSizeAligned = cached.sizeAligned;
+        s.impactData = cached.data;
+        if constexpr (AddTraj) {
+            s.trajectories = cached.trajectories;
         }
-        std::size_t length = ceil(static_cast<double>(s.impactSize) / vSize);
-        std::size_t assigned = assignThreadNum(length, nThreads);
-        mtFunctionRunner(
-            assigned, length, s.impactSize, [&](const std::size_t i) {
-                impactGroup<AddTraj, Numerical, false, nonAP>(i, s);
+    }
+
+    // Also stored under ballistic (if not empty) for shells that share the
+    // trajectories
+    template <bool AddTraj>
+    void storeImpact(const std::string &key, const shell &s,
+                     const std::string &ballistic = {}) const {
+        if (!caching(key)) return;
+        cachedResult result{s.impactSize, s.impactSizeAligned, s.impactData};
+        if constexpr (AddTraj) {
+            result.trajectories = s.trajectories;
+        }
+        auto stored = std::make_shared<const cachedResult>(std::move(result));
+        if (!ballistic.empty()) cache.insert(ballistic, stored);
+        cache.insert(key, std::move(stored));
+    }
+
+    // Impact data of a shell that flies the same trajectories
+    template <bool AddTraj>
+    void shareImpact(const shell &source, shell &s) const {
+        s.impactSize = source.impactSize;
+        s.impactSizeAligned = source.impactSizeAligned;
+        s.impactData = source.impactData;
+        if constexpr (AddTraj) {
+            s.trajectories = source.trajectories;
+        }
+    }
+
+    template <bool AddTraj, impact::columnMask Mask = impact::allColumns>
+    void prepareImpact(shell &s) const {
+        prepareImpact<AddTraj, Mask>(
+            s,
+            static_cast<std::size_t>(maxA / precision - minA / precision) + 1,
+            [&](const std::size_t i) { return precision * i + minA; });
+    }
+
+    // angle(i): launch angle of row i in degrees - used to size its
+    // trajectory slot
+    template <bool AddTraj, impact::columnMask Mask = impact::allColumns,
+              typename Angle>
+    void prepareImpact(shell &s, const std::size_t rows, Angle angle) const {
+        s.impactSize = rows;
+        s.impactSizeAligned = calculateAlignmentSize(s.impactSize);
+        if constexpr (AddTraj) {
+            s.trajectories.reset(s.impactSize, [&](const std::size_t i) {
+                return trajectoryPoints(s, angle(i));
             });
+        }
+        s.impactData.resize(storedColumns(Mask) * s.impactSizeAligned);
+    }
 
-        s.completedImpact = true;
+    // Columns of impactData kept for Mask - up to the highest one wanted and
+    // at least up to the ones refilled lanes park their state in
+    static constexpr std::size_t storedColumns(const impact::columnMask Mask) {
+        std::size_t stored =
+            std::max({toUnderlying(parkedV_x), toUnderlying(parkedV_y),
+                      toUnderlying(parkedTime)}) +
+            1;
+        for (std::size_t c = stored; c < impact::maxColumns; ++c) {
+            if ((Mask >> c) & 1) stored = c + 1;
+        }
+        return stored;
     }
 
-    template <auto Numerical>
-    void calculateFit(shell &s, std::size_t nThreads =
-                                    std::thread::hardware_concurrency()) const {
+    // Points recorded over the flight time in vacuum - drag shortens it
+    std::size_t trajectoryPoints(const shell &s, const double angle) const {
+        const double v_y = s.v0 * sin(angle * M_PI / 180);
+        const double t = std::max(
+            (v_y + sqrt(v_y * v_y + 2 * g * std::max(y0, 0.))) / g, 0.);
+        const double steps = t / dt_min;
+        double points = steps;
+        switch (recordMode) {
+            case recording::all:
+                break;
+            case recording::stride:
+                points = steps / std::max<std::size_t>(recordStride, 1);
+                break;
+            case recording::spacing:
+                points = s.v0 * t / recordSpacing;
+                break;
+            case recording::simplify:
+                // Chords of a vacuum trajectory stay within the tolerance
+                // over sqrt(8 tolerance / g) * v_x - twice as many for the
+                // tighter turn drag causes before impact
+                points = 2 * t * sqrt(g / (8 * recordTolerance));
+                break;
+        }
+        return static_cast<std::size_t>(std::min(points, steps)) + 2;
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid, bool Fit, bool nonAP,
+              impact::columnMask Mask = impact::allColumns,
+              typename Visitor = noVisitor, typename Epilogue = noEpilogue>
+    void impactRunner(shell &s, std::size_t nThreads,
+                      Visitor &visitor = unvisited,
+                      Epilogue epilogue = {}) const {
         if (nThreads > std::thread::hardware_concurrency()) {
             nThreads = std::thread::hardware_concurrency();
         }
+        if constexpr (!isMultistep<Numerical>()) {
+            // Multistep histories can't be restarted per lane - these always
+            // run in fixed groups
+            if (laneRefill) {
+                constexpr std::size_t chunk = vSize * refillGroups;
+                std::size_t length =
+                    ceil(static_cast<double>(s.impactSize) / chunk);
+                std::size_t assigned = assignThreadNum(length, nThreads);
+                mtFunctionRunner(
+                    assigned, length, [&](const std::size_t i) {
+                        // i is in units of vSize
+                        const std::size_t begin = i * refillGroups;
+                        const rowRange range{
+                            &s, begin, std::min(begin + chunk, s.impactSize)};
+                        impactRefill<AddTraj, Numerical, Hybrid, Fit>(
+                            &range, 1,
+                            [&](const std::size_t j, shell &target,
+                                const std::array<Real, vSize * 3> &vt) {
+                                impactColumns<nonAP, Mask>(j, target, vt);
+                                epilogue(j, target);
+                            },
+                            visitor);
+                    });
+                return;
+            }
+        }
         std::size_t length = ceil(static_cast<double>(s.impactSize) / vSize);
         std::size_t assigned = assignThreadNum(length, nThreads);
-        mtFunctionRunner(assigned, length, s.impactSize,
+        mtFunctionRunner(assigned, length,
                          [&](const std::size_t i) {
-                             impactGroup<false, Numerical, true, false>(i, s);
+                             impactGroup<AddTraj, Numerical, Hybrid, Fit,
+                                         nonAP, Mask>(i, s, visitor);
+                             epilogue(i, s);
                          });
     }
 
-   private:
+    // Brings the impact data up to date with the settings it was last
+    // computed with - forwardEuler if it never was
+    void checkRunImpact(shell &s) const {
+        switch (s.impactNumerical) {
+            case numerical::forwardEuler:
+                return checkRunImpact<numerical::forwardEuler>(s);
+            case numerical::rungeKutta2:
+                return checkRunImpact<numerical::rungeKutta2>(s);
+            case numerical::rungeKutta4:
+                return checkRunImpact<numerical::rungeKutta4>(s);
+            case numerical::adamsBashforth5:
+                return checkRunImpact<numerical::adamsBashforth5>(s);
+            case numerical::dormandPrince45:
+                return checkRunImpact<numerical::dormandPrince45>(s);
+        }
+    }
+
+    template <numerical Numerical>
+    void checkRunImpact(shell &s) const {
+        if (s.impactHybrid) {
+            if (s.impactAddTraj) {
+                checkRunImpact<true, Numerical, true>(s);
+            } else {
+                checkRunImpact<false, Numerical, true>(s);
+            }
+        } else {
+            if (s.impactAddTraj) {
+                checkRunImpact<true, Numerical, false>(s);
+            } else {
+                checkRunImpact<false, Numerical, false>(s);
+            }
+        }
+    }
+
+    template <bool AddTraj, numerical Numerical, bool Hybrid>
     void checkRunImpact(shell &s) const {
-        if (!s.completedImpact) {
+        using parameters::group, parameters::groups;
+        if (!s.completedImpact || s.impactMask != impact::allColumns ||
+            (s.changedParameters & group(groups::trajectory))) {
             std::cout << "Standard Not Calculated - Running automatically\n";
-            calculateImpact<false, numerical::forwardEuler, false>(s);
+            calculateImpact<AddTraj, Numerical, Hybrid>(s);
+        } else if (s.changedParameters) {
+            updatePenetration<impact::allColumns>(
+                s, std::thread::hardware_concurrency());
+            // Same trajectories - only the shell hash in the key changes
+            if (!s.impactSignature.empty()) {
+                s.impactSignature = impactKey<AddTraj, Numerical, Hybrid>(s);
+            }
+            s.changedParameters = 0;
         }
     }
 
@@ -926,7 +2577,7 @@ class shellCalc {
         static_assert(toUnderlying(fusing) <= 2 && toUnderlying(fusing) >= 0,
                       "Invalid fusing parameter");
         enum class caIndex { ricochet0, ricochet1, penetration, fuse };
-#if defined(__SSE4_2__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 6
         const VT fallAngleAdjusted =
                      VT().load(s.get_impactPtr(
                          i,
@@ -942,9 +2593,10 @@ class shellCalc {
                     return VT(0);
                 }
             } else {
-                return static_cast<VT>(VT(thickness) <= rawPenetration) &
-                       (acos(VT(thickness) / rawPenetration) +
-                        VT(s.get_normalizationR()));
+                return select(VT(thickness) <= rawPenetration,
+                              acos(VT(thickness) / rawPenetration) +
+                                  VT(s.get_normalizationR()),
+                              VT(0));
             }
         }();
 
@@ -1023,26 +2675,26 @@ class shellCalc {
         // acos's - but that's there so that when acos vectorization is
         // added to compilers this will autovectorize
         const auto computeAngleFromCritical =
-            [](double criticalAngle, double fallAngleAdjusted) -> double {
-            const double quotient = cos(criticalAngle) / cos(fallAngleAdjusted);
-            const double result = acos(quotient);
+            [](Real criticalAngle, Real fallAngleAdjusted) -> Real {
+            const Real quotient = cos(criticalAngle) / cos(fallAngleAdjusted);
+            const Real result = acos(quotient);
             return fabs(quotient) > 1 ? 0 : result;
         };
 
         for (std::size_t j = 0; j < vSize; j++) {
-            const double fallAngleAdjusted =
+            const Real fallAngleAdjusted =
                 s.impactData[i + j +
                              toUnderlying(impact::impactIndices::
                                               impactAngleHorizontalRadians) *
                                  ISA] +
                 inclination_R;
-            const double rawPenetration =
+            const Real rawPenetration =
                 s.impactData[i + j +
                              toUnderlying(
                                  impact::impactIndices::rawPenetration) *
                                  ISA];
 
-            const double penetrationCriticalAngle = [&]() {
+            const Real penetrationCriticalAngle = [&]() {
                 if constexpr (nonAP) {
                     if constexpr (nonAPPerforated) {
                         return M_PI_2;
@@ -1068,7 +2720,7 @@ class shellCalc {
                 }
             }();
 
-            std::array<double, 4> out;
+            std::array<Real, 4> out;
             for (uint32_t k = 0; k < 2; k++) {
                 out[k] = computeAngleFromCritical(criticalAngles[k],
                                                   fallAngleAdjusted);
@@ -1156,6 +2808,12 @@ class shellCalc {
                          const std::size_t nThreads =
                              std::thread::hardware_concurrency()) const {
         checkRunImpact(s);
+        const std::string key = angleKey(s, thickness, inclination);
+        if (const auto cached = cacheLookup(key)) {
+            s.angleData = cached->data;
+            s.completedAngles = true;
+            return;
+        }
 
         s.angleData.resize(angle::maxColumns * s.impactSizeAligned);
         // std::copy_n(s.get_impactPtr(0, impact::impactIndices::distance),
@@ -1167,41 +2825,85 @@ class shellCalc {
         std::size_t assigned = assignThreadNum(length, nThreads);
 
         const double inclination_R = inclination / 180 * M_PI;
-        const double fusingAngle = [&]() -> double {
-            if (thickness >= s.threshold) {
-                return 0;
+        const double fusingAngle = fusingAngleOf(thickness, s);
+        const anglesKernel angles =
+            selectAngles<nonAP, nonAPPerforated, disableRicochet>(
+                thickness, fusingAngle, s);
+        mtFunctionRunner(
+            assigned, length, [&](const std::size_t i) {
+                (this->*angles)(i, thickness, inclination_R, fusingAngle, s);
+            });
+        if (caching(key)) cacheStore(key, {s.impactSize, 0, s.angleData});
+        s.completedAngles = true;
+    }
+
+   private:
+    using anglesKernel = void (basic_shellCalc::*)(std::size_t, double,
+                                                   double, double,
+                                                   shell &) const;
+
+    static double fusingAngleOf(const double thickness, const shell &s) {
+        if (thickness >= s.threshold) {
+            return 0;
+        } else {
+            return acos(thickness / s.threshold) + s.normalizationR;
+        }
+    }
+
+    // multiAngles instance for the shell and plate
+    anglesKernel selectAngles(const double thickness, const double fusingAngle,
+                              const shell &s) const {
+        if (s.enableNonAP) {
+            if (s.nonAP >= thickness) {
+                return selectAngles<true, true>(thickness, fusingAngle, s);
             } else {
-                return acos(thickness / s.threshold) + s.get_normalizationR();
+                return selectAngles<true, false>(thickness, fusingAngle, s);
             }
-        }();
+        } else {
+            return selectAngles<false, false>(thickness, fusingAngle, s);
+        }
+    }
 
+    template <bool nonAP, bool nonAPPerforated>
+    anglesKernel selectAngles(const double thickness, const double fusingAngle,
+                              const shell &s) const {
+        if (s.ricochet0 >= 90) {
+            return selectAngles<nonAP, nonAPPerforated, true>(
+                thickness, fusingAngle, s);
+        } else {
+            return selectAngles<nonAP, nonAPPerforated, false>(
+                thickness, fusingAngle, s);
+        }
+    }
+
+    template <bool nonAP, bool nonAPPerforated, bool disableRicochet>
+    anglesKernel selectAngles(const double thickness, const double fusingAngle,
+                              const shell &s) const {
         if (thickness > s.threshold) {
-            mtFunctionRunner(
-                assigned, length, s.impactSize, [&](const std::size_t i) {
-                    multiAngles<fuseStatus::always, nonAP, nonAPPerforated,
-                                disableRicochet>(i, thickness, inclination_R,
-                                                 fusingAngle, s);
-                });
+            return &basic_shellCalc::multiAngles<fuseStatus::always, nonAP,
+                                                 nonAPPerforated,
+                                                 disableRicochet>;
+        } else if (fusingAngle > M_PI_2) {
+            return &basic_shellCalc::multiAngles<fuseStatus::never, nonAP,
+                                                 nonAPPerforated,
+                                                 disableRicochet>;
         } else {
-            if (fusingAngle > M_PI_2) {
-                mtFunctionRunner(
-                    assigned, length, s.impactSize, [&](const std::size_t i) {
-                        multiAngles<fuseStatus::never, nonAP, nonAPPerforated,
-                                    disableRicochet>(
-                            i, thickness, inclination_R, fusingAngle, s);
-                    });
-            } else {
-                mtFunctionRunner(
-                    assigned, length, s.impactSize, [&](const std::size_t i) {
-                        multiAngles<fuseStatus::check, nonAP, nonAPPerforated,
-                                    disableRicochet>(
-                            i, thickness, inclination_R, fusingAngle, s);
-                    });
-            }
+            return &basic_shellCalc::multiAngles<fuseStatus::check, nonAP,
+                                                 nonAPPerforated,
+                                                 disableRicochet>;
         }
-        s.completedAngles = true;
     }
 
+    std::string angleKey(const shell &s, const double thickness,
+                         const double inclination) const {
+        const bool nonAP = s.enableNonAP,
+                   nonAPPerforated = nonAP && s.nonAP >= thickness,
+                   disableRicochet = s.ricochet0 >= 90;
+        return derivedKey('a', s, nonAP, nonAPPerforated, disableRicochet,
+                          thickness, inclination);
+    }
+
+   public:
     // Dispersion Section
     void calculateDispersion(
         const dispersion::verticalTypes verticalType, shell &s,
@@ -1221,27 +2923,61 @@ class shellCalc {
         shell &s,
         std::size_t nThreads = std::thread::hardware_concurrency()) const {
         checkRunImpact(s);
+        const std::string key = dispersionKey(s, verticalType);
+        if (const auto cached = cacheLookup(key)) {
+            s.dispersionData = cached->data;
+            s.completedDispersion = true;
+            return;
+        }
         s.dispersionData.resize(dispersion::maxColumns * s.impactSizeAligned);
         std::size_t length = ceil(static_cast<double>(s.impactSize) / vSize);
         std::size_t assigned = assignThreadNum(length, nThreads);
+        const dispersionKernel group = selectDispersion<verticalType>(s);
+        mtFunctionRunner(assigned, length, [&](const std::size_t i) {
+            (this->*group)(i, s);
+        });
+        if (caching(key)) cacheStore(key, {s.impactSize, 0, s.dispersionData});
+        s.completedDispersion = true;
+    }
+
+    using dispersionKernel = void (basic_shellCalc::*)(std::size_t,
+                                                       shell &) const;
+
+    // dispersionGroup instance for the shell
+    dispersionKernel selectDispersion(
+        const dispersion::verticalTypes verticalType, const shell &s) const {
+        using verticalTypes = dispersion::verticalTypes;
+        if (verticalType == verticalTypes::horizontal) {
+            return selectDispersion<verticalTypes::horizontal>(s);
+        } else if (verticalType == verticalTypes::normal) {
+            return selectDispersion<verticalTypes::normal>(s);
+        } else {
+            return selectDispersion<verticalTypes::vertical>(s);
+        }
+    }
+
+    template <dispersion::verticalTypes verticalType>
+    dispersionKernel selectDispersion(const shell &s) const {
         if (s.zeroDelimSlope >= s.delimMaxSlope) {
-            mtFunctionRunner(assigned, length, s.impactSize,
-                             [&](const std::size_t i) {
-                                 dispersionGroup<true, verticalType>(i, s);
-                             });
+            return &basic_shellCalc::dispersionGroup<true, verticalType>;
         } else {
-            mtFunctionRunner(assigned, length, s.impactSize,
-                             [&](const std::size_t i) {
-                                 dispersionGroup<false, verticalType>(i, s);
-                             });
+            return &basic_shellCalc::dispersionGroup<false, verticalType>;
         }
-        s.completedDispersion = true;
+    }
+
+    std::string dispersionKey(const shell &s,
+                              const dispersion::verticalTypes verticalType)
+        const {
+        return derivedKey('d', s, verticalType, s.idealRadius, s.minRadius,
+                          s.idealDistance, s.taperDistance, s.delim,
+                          s.zeroRadius, s.delimRadius, s.maxRadius,
+                          s.maxDistance, s.sigma);
     }
 
     template <bool convex, dispersion::verticalTypes verticalType>
     void dispersionGroup(const std::size_t startIndex, shell &s) const {
         using verticalTypes = dispersion::verticalTypes;
-#if defined(__SSE4_2__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 6
         const std::size_t i = startIndex;
         const VT distance =
             VT().load(s.get_impactPtr(i, impact::impactIndices::distance));
@@ -1314,18 +3050,18 @@ class shellCalc {
 #else
         for (uint8_t j = 0; j < vSize; ++j) {
             const std::size_t i = startIndex + j;
-            const double distance =
+            const Real distance =
                 s.get_impact(i, impact::impactIndices::distance);
-            const double impactAngle = s.get_impact(
+            const Real impactAngle = s.get_impact(
                 i, impact::impactIndices::impactAngleHorizontalRadians);
-            const double horizontal =
+            const Real horizontal =
                 std::min(s.horizontalSlope * distance + s.horizontalIntercept,
                          s.taperSlope * distance);
             // Continuous piecewise linear [2] function
             // Will always be convex - pick the lower of the two
 
-            const double verticalRatioUncapped = [&]() -> double {
-                const double delimMax = s.delimMaxSlope * distance +
+            const Real verticalRatioUncapped = [&]() -> Real {
+                const Real delimMax = s.delimMaxSlope * distance +
                                         s.delimMaxIntercept,
                              zeroDelim = s.zeroDelimSlope * distance +
                                          s.zeroDelimIntercept;
@@ -1337,13 +3073,13 @@ class shellCalc {
             }();
             // Continuous piecewise linear [2] function
             // Will pick based on convexity
-            const double verticalRatio =
-                std::min(verticalRatioUncapped, s.maxRadius);
+            const Real verticalRatio =
+                std::min<Real>(verticalRatioUncapped, s.maxRadius);
             // std::cout << distance << " " << verticalRatio << "\n";
             // Results will never be higher than s.maxRadius
 
-            const double vertical = [&]() -> double {
-                const double verticalNormal = horizontal * verticalRatio;
+            const Real vertical = [&]() -> Real {
+                const Real verticalNormal = horizontal * verticalRatio;
                 if constexpr (verticalType == verticalTypes::horizontal) {
                     return verticalNormal / sin(impactAngle * -1);
                 } else if constexpr (verticalType == verticalTypes::normal) {
@@ -1352,7 +3088,7 @@ class shellCalc {
                     return verticalNormal / cos(impactAngle * -1);
                 }
             }();
-            const double area = M_PI * horizontal * vertical;
+            const Real area = M_PI * horizontal * vertical;
 
             s.get_dispersion(i, dispersion::dispersionIndices::maxHorizontal) =
                 horizontal;
@@ -1383,12 +3119,12 @@ class shellCalc {
 
    private:
     template <bool fast>
-    void postPenTraj(const std::size_t i, shell &s, double v_x, double v_y,
-                     double v_z, double thickness) const {
-        const double notFusedCode = -1;
+    void postPenTraj(const std::size_t i, shell &s, Real v_x, Real v_y,
+                     Real v_z, Real thickness) const {
+        const Real notFusedCode = -1;
         if constexpr (fast) {
             const bool positive = v_x > 0;
-            const double x = v_x * s.fuseTime * positive;
+            const Real x = v_x * s.fuseTime * positive;
             s.get_postPen(i, post::postPenIndices::x, 0) = x;
             s.get_postPen(i, post::postPenIndices::y, 0) =
                 v_y * s.fuseTime * positive;
@@ -1399,9 +3135,9 @@ class shellCalc {
             s.get_postPen(i, post::postPenIndices::xwf, 0) =
                 (fuse)*x + !(fuse)*notFusedCode;
         } else {
-            const double k = s.get_k();
-            const double cw_2 = s.get_cw_2();
-            double T, p, rho, t;
+            const Real k = s.get_k();
+            const Real cw_2 = s.get_cw_2();
+            Real rho, t;
 
             /* [indices]           0     1     2
              * pos                 x     y     z
@@ -1410,9 +3146,9 @@ class shellCalc {
              * dragIntermediary    ad_x  ad_y  ad_z
              * xz_dragIntermediary ad_x  ad_z
              */
-            double pos[3], velocities[3], velocitiesSquared[3],
+            Real pos[3], velocities[3], velocitiesSquared[3],
                 dragIntermediary[3];
-            double xz_dragIntermediary[2];
+            Real xz_dragIntermediary[2];
             pos[0] = xf0, pos[1] = yf0, pos[2] = xf0;
             velocities[0] = v_x, velocities[1] = v_y, velocities[2] = v_z;
             t = 0;
@@ -1423,9 +3159,7 @@ class shellCalc {
                     }
                     // Calculate air density - likely unnecessary for this
                     // section as distances are so short
-                    T = t0 - L * pos[1];
-                    p = p0 * pow((1 - L * pos[1] / t0), gMRL);
-                    rho = p * M / (R * T);
+                    rho = airDensity(pos[1]);
 
                     // Calculated drag deceleration
 
@@ -1473,7 +3207,7 @@ class shellCalc {
     void multiPostPen(std::size_t i, const double thickness,
                       const double inclination_R, shell &s) const {
         std::size_t distIndex = (i < s.impactSize) ? i : i % s.impactSize;
-#if defined(__SSE4_2__) || defined(__AVX__)
+#if WOWS_SHELL_INSTRSET >= 6
         VT hAngleV, vAngleV, v0V, penetrationV, eThicknessV, v_x, v_y, v_z;
         if (s.postPenSize - i >= vSize) {
             hAngleV.load(s.get_postPenPtr(i, post::postPenIndices::angle, 0));
@@ -1515,7 +3249,7 @@ class shellCalc {
         eThicknessV = eThickness;
 
 #else
-        std::array<double, vSize> hAngleV, vAngleV, v0V, penetrationV,
+        std::array<Real, vSize> hAngleV, vAngleV, v0V, penetrationV,
             eThicknessV, v_x, v_y, v_z;
 
         std::copy_n(s.get_postPenPtr(i, post::postPenIndices::angle, 0),
@@ -1533,26 +3267,26 @@ class shellCalc {
             vSize, v0V.data());
 
         for (uint32_t l = 0; l < vSize; l++) {
-            const double HA_R =
+            const Real HA_R =
                 hAngleV[l] * M_PI / 180;  // lateral  angle radians
-            const double VA_R =
+            const Real VA_R =
                 vAngleV[l] + inclination_R;  // vertical angle radians
-            const double cAngle = acos(cos(HA_R) * cos(VA_R));
-            const double nCAngle =
+            const Real cAngle = acos(cos(HA_R) * cos(VA_R));
+            const Real nCAngle =
                 calcNormalizationR(cAngle, s.get_normalizationR());
-            const double eThickness = thickness / cos(nCAngle);
-            const double pPV =
+            const Real eThickness = thickness / cos(nCAngle);
+            const Real pPV =
                 v0V[l] * (1 - exp(1 - penetrationV[l] / eThickness));
 
             if constexpr (changeDirection) {
-                const double hFAngle =
+                const Real hFAngle =
                     atan(tan(nCAngle) * tan(HA_R) / tan(cAngle));
-                const double vFAngle =
+                const Real vFAngle =
                     atan(tan(nCAngle) * cos(hFAngle) * tan(VA_R) / cos(HA_R) /
                          tan(cAngle));
 
-                const double v_x0 = pPV * cos(vFAngle) * cos(hFAngle);
-                const double v_y0 = pPV * cos(vFAngle) * sin(hFAngle);
+                const Real v_x0 = pPV * cos(vFAngle) * cos(hFAngle);
+                const Real v_y0 = pPV * cos(vFAngle) * sin(hFAngle);
 
                 v_x[l] = v_x0 * cos(inclination_R) + v_y0 * sin(inclination_R);
                 v_z[l] = v_y0 * cos(inclination_R) + v_x0 * sin(inclination_R);
@@ -1581,7 +3315,7 @@ class shellCalc {
         for (std::size_t i = angles.size() * id / assigned;
              i < angles.size() * (id + 1) / assigned; i++) {
             std::fill_n(s.get_postPenPtr(0, post::postPenIndices::angle, i),
-                        s.impactSize, static_cast<double>(angles[i]));
+                        s.impactSize, static_cast<Real>(angles[i]));
         }
     }
 
@@ -1641,6 +3375,17 @@ class shellCalc {
                           shell &s, std::vector<double> &angles,
                           const std::size_t nThreads) const {
         checkRunImpact(s);
+        std::string key = derivedKey('p', s, changeDirection, fast, thickness,
+                                     inclination, xf0, yf0, dtf);
+        if (!key.empty()) {
+            for (const double angle : angles) appendKey(key, angle);
+        }
+        if (const auto cached = cacheLookup(key)) {
+            s.postPenSize = cached->size;
+            s.postPenData = cached->data;
+            s.completedPostPen = true;
+            return;
+        }
 
         s.postPenSize = s.impactSize * angles.size();
         s.postPenData.resize(6 * s.postPenSize);
@@ -1671,14 +3416,71 @@ class shellCalc {
         double inclination_R = M_PI / 180 * inclination;
         std::size_t length = ceil(static_cast<double>(s.postPenSize) / vSize);
         std::size_t assigned = assignThreadNum(length, nThreads);
-        mtFunctionRunner(assigned, length, s.postPenSize,
+        mtFunctionRunner(assigned, length,
                          [&](const std::size_t i) {
                              multiPostPen<changeDirection, fast>(
                                  i, thickness, inclination_R, s);
                          });
 
+        if (caching(key)) cacheStore(key, {s.postPenSize, 0, s.postPenData});
         s.completedPostPen = true;
     }
+
+    // Asynchronous calls - queued on the thread pool, returning right away.
+    // The calculator has to outlive the job and the shell mustn't be used
+    // until it's ready - dependent steps are chained with then, e.g.
+    // calculateImpactAsync<...>(s).then([&] { calculateAngles(...); })
+    // Without worker threads they run inline.
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    utility::completion calculateImpactAsync(
+        shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        return utility::async(*tp, [this, &s, nThreads]() {
+            calculateImpact<AddTraj, Numerical, Hybrid>(s, nThreads);
+        });
+    }
+
+    template <bool AddTraj, auto Numerical, bool Hybrid>
+    utility::completion calculateImpactAnglesDispersionAsync(
+        shell &s, const double thickness, const double inclination,
+        const dispersion::verticalTypes verticalType,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        return utility::async(*tp, [=, &s]() {
+            calculateImpactAnglesDispersion<AddTraj, Numerical, Hybrid>(
+                s, thickness, inclination, verticalType, nThreads);
+        });
+    }
+
+    utility::completion calculateAnglesAsync(
+        const double thickness, const double inclination, shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        return utility::async(*tp, [=, &s]() {
+            calculateAngles(thickness, inclination, s, nThreads);
+        });
+    }
+
+    utility::completion calculateDispersionAsync(
+        const dispersion::verticalTypes verticalType, shell &s,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        return utility::async(*tp, [=, &s]() {
+            calculateDispersion(verticalType, s, nThreads);
+        });
+    }
+
+    // angles is copied into the job
+    utility::completion calculatePostPenAsync(
+        const double thickness, const double inclination, shell &s,
+        std::vector<double> angles, const bool changeDirection = false,
+        const bool fast = false,
+        std::size_t nThreads = std::thread::hardware_concurrency()) const {
+        return utility::async(*tp, [=, &s]() mutable {
+            calculatePostPen(thickness, inclination, s, angles,
+                             changeDirection, fast, nThreads);
+        });
+    }
 };
 
+using shellCalc = basic_shellCalc<double>;
+using shellCalcFloat = basic_shellCalc<float>;
+}  // namespace WOWS_SHELL_ISA
 }  // namespace wows_shell
@@ -0,0 +1,83 @@
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+#include "../shellCPP.hpp"
+
+// Async results have to match the synchronous ones bit for bit, every
+// continuation has to run exactly once and errors have to reach get
+
+bool same(const double a, const double b) {
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+std::size_t countMismatches(wows_shell::shell &reference,
+                            wows_shell::shell &compared) {
+    using namespace wows_shell;
+    std::size_t mismatches = reference.impactSize != compared.impactSize;
+    for (std::size_t i = 0; i < reference.impactSize; ++i) {
+        for (std::size_t j = 0; j < impact::maxColumns; ++j) {
+            mismatches +=
+                !same(reference.get_impact(i, j), compared.get_impact(i, j));
+        }
+        for (std::size_t j = 0; j < angle::maxColumns; ++j) {
+            mismatches +=
+                !same(reference.get_angle(i, j), compared.get_angle(i, j));
+        }
+    }
+    return mismatches;
+}
+
+int main() {
+    using namespace wows_shell;
+    // Workers whatever the machine - without them jobs would run inline and
+    // the queued hand-offs would go untested
+    shellCalc calc(4);
+    calc.set_max(30);
+    // Without a cache the async calls have to integrate themselves
+    calc.set_cacheSize(0);
+    shellParams sp = {.460, 780, .292, 1460, 2574, 6, .033, 76, 45, 60, 0};
+    shell reference(sp, "reference"), compared(sp, "compared");
+
+    calc.calculateImpact<false, numerical::rungeKutta4, false>(reference);
+    calc.calculateAngles(70, 0, reference);
+
+    bool passed = true;
+    std::atomic_size_t anglesRuns{0}, finalRuns{0};
+    utility::completion impactDone =
+        calc.calculateImpactAsync<false, numerical::rungeKutta4, false>(
+            compared);
+    utility::completion anglesDone = impactDone.then([&] {
+        calc.calculateAngles(70, 0, compared);
+        ++anglesRuns;
+    });
+    anglesDone.then([&] { ++finalRuns; }).get();
+    // Chained after the job finished - queued right away instead
+    impactDone.then([&] { ++finalRuns; }).get();
+
+    const std::size_t mismatches = countMismatches(reference, compared);
+    std::cout << "Async mismatches: " << mismatches
+              << " continuation runs: " << anglesRuns << " " << finalRuns
+              << "\n";
+    passed &= mismatches == 0 && anglesRuns == 1 && finalRuns == 2;
+
+    // A throwing job skips its continuations and fails every later get
+    std::atomic_size_t skippedRuns{0};
+    utility::completion failed =
+        utility::async(*calc.get_threadPool(),
+                       [] { throw std::runtime_error("job failed"); });
+    utility::completion chained = failed.then([&] { ++skippedRuns; });
+    for (const utility::completion *c : {&failed, &chained}) {
+        try {
+            c->get();
+            std::cout << "Exception was lost\n";
+            passed = false;
+        } catch (const std::runtime_error &e) {
+            std::cout << "Rethrown: " << e.what() << "\n";
+        }
+    }
+    passed &= skippedRuns == 0;
+
+    if (!passed) std::cout << "Async test failed\n";
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "../shellCPP.hpp"
+
+// Compares the float calculations against the double reference
+template <typename Reference, typename Compared, typename Get>
+void printDeviation(const char *name, Reference &reference, Compared &compared,
+                    const std::size_t rows, const std::size_t columns,
+                    Get get) {
+    std::cout << name << " - max absolute | max relative deviation\n";
+    for (std::size_t j = 0; j < columns; ++j) {
+        double absolute = 0, relative = 0;
+        for (std::size_t i = 0; i < rows; ++i) {
+            const double r = get(reference, i, j), c = get(compared, i, j);
+            if (!std::isfinite(r) || !std::isfinite(c)) continue;
+            const double error = std::fabs(r - c);
+            absolute = std::max(absolute, error);
+            if (std::fabs(r) > 1e-6)
+                relative = std::max(relative, error / std::fabs(r));
+        }
+        std::cout << std::setw(4) << j << " " << std::scientific
+                  << std::setprecision(3) << absolute << " " << relative
+                  << "\n";
+    }
+    std::cout << std::defaultfloat;
+}
+
+// Best of a few single threaded runs on fresh shells - seconds
+template <auto Numerical, typename Shell, typename Calc>
+double impactTime(Calc &calc, const wows_shell::shellParams &sp) {
+    constexpr int runs = 5;
+    double best = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < runs; ++i) {
+        Shell s(sp, "timed");
+        auto t1 = std::chrono::steady_clock::now();
+        calc.template calculateImpact<false, Numerical, false>(s, 1);
+        auto t2 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t2 - t1).count());
+    }
+    return best;
+}
+
+template <auto Numerical>
+void compare(const char *name, wows_shell::shellCalc &calcDouble,
+             wows_shell::shellCalcFloat &calcFloat,
+             wows_shell::shell &doubleShell,
+             wows_shell::shellFloat &floatShell,
+             const wows_shell::shellParams &sp) {
+    using namespace wows_shell;
+    std::cout << "Numerical: " << name << "\n";
+    const double doubleTime = impactTime<Numerical, shell>(calcDouble, sp),
+                 floatTime = impactTime<Numerical, shellFloat>(calcFloat, sp);
+    std::cout << "Impact s - double: " << doubleTime
+              << " float: " << floatTime
+              << " speedup: " << doubleTime / floatTime << "\n";
+    calcDouble.calculateImpact<false, Numerical, false>(doubleShell);
+    calcFloat.calculateImpact<false, Numerical, false>(floatShell);
+
+    std::vector<double> angles = {0, 10, 20};
+    calcDouble.calculateAngles(70, 0, doubleShell);
+    calcFloat.calculateAngles(70, 0, floatShell);
+    calcDouble.calculateDispersion(dispersion::verticalTypes::horizontal,
+                                   doubleShell);
+    calcFloat.calculateDispersion(dispersion::verticalTypes::horizontal,
+                                  floatShell);
+    calcDouble.calculatePostPen(70, 0, doubleShell, angles, true, false);
+    calcFloat.calculatePostPen(70, 0, floatShell, angles, true, false);
+
+    const std::size_t rows = doubleShell.impactSize;
+    printDeviation("Impact", doubleShell, floatShell, rows,
+                   impact::maxColumns, [](auto &s, auto i, auto j) {
+                       return static_cast<double>(s.get_impact(i, j));
+                   });
+    printDeviation("Angle", doubleShell, floatShell, rows, angle::maxColumns,
+                   [](auto &s, auto i, auto j) {
+                       return static_cast<double>(s.get_angle(i, j));
+                   });
+    printDeviation("Dispersion", doubleShell, floatShell, rows,
+                   dispersion::maxColumns, [](auto &s, auto i, auto j) {
+                       return static_cast<double>(s.get_dispersion(i, j));
+                   });
+    printDeviation("Post-Penetration", doubleShell, floatShell,
+                   doubleShell.postPenSize, post::maxColumns,
+                   [](auto &s, auto i, auto j) {
+                       return static_cast<double>(s.get_postPen(i, j, 0));
+                   });
+}
+
+int main() {
+    using namespace wows_shell;
+    shellCalc calcDouble;
+    shellCalcFloat calcFloat;
+    calcDouble.set_max(45);
+    calcFloat.set_max(45);
+    // Otherwise the two can land a time step apart
+    calcDouble.set_exactImpact(true);
+    calcFloat.set_exactImpact(true);
+    // Timed runs have to integrate rather than hit the cache
+    calcDouble.set_cacheSize(0);
+    calcFloat.set_cacheSize(0);
+
+    shellParams sp = {.460, 780, .292, 1460, 2574, 6, .033, 76, 45, 60, 0};
+    dispersionParams dp = {10, 2.8, 1000, 5000, 0.5, 0.2, 0.6, 0.8, 26630, 2.1};
+    shell doubleShell(sp, dp, "Yamato");
+    shellFloat floatShell(sp, dp, "Yamato");
+
+    compare<numerical::rungeKutta4>("RungeKutta4", calcDouble, calcFloat,
+                                    doubleShell, floatShell, sp);
+    compare<numerical::adamsBashforth5>("AdamsBashforth5", calcDouble,
+                                        calcFloat, doubleShell, floatShell, sp);
+    compare<numerical::dormandPrince45>("DormandPrince45", calcDouble,
+                                        calcFloat, doubleShell, floatShell, sp);
+    return 0;
+}
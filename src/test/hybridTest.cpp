@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "../shellCPP.hpp"
+
+// Counts the integration steps of every row through the step visitor
+template <auto Numerical, bool Hybrid>
+std::size_t countSteps(wows_shell::shellCalc &calc, wows_shell::shell &s) {
+    using stepState = wows_shell::shellCalc::stepState;
+    std::atomic_size_t steps{0};
+    calc.calculateImpact<false, Numerical, Hybrid>(
+        s, [&](const stepState &step) {
+            steps += std::count(step.stepped.begin(), step.stepped.end(), true);
+        });
+    return steps;
+}
+
+double maxRelativeDeviation(wows_shell::shell &reference,
+                            wows_shell::shell &compared) {
+    double relative = 0;
+    for (std::size_t i = 0; i < reference.impactSize; ++i) {
+        for (std::size_t j = 0; j < wows_shell::impact::maxColumns; ++j) {
+            const double r = reference.get_impact(i, j),
+                         c = compared.get_impact(i, j);
+            if (!std::isfinite(r) || std::fabs(r) < 1e-6) continue;
+            relative = std::max(relative, std::fabs(r - c) / std::fabs(r));
+        }
+    }
+    return relative;
+}
+
+// Fine and Hybrid runs of one method - false if Hybrid saved no steps
+template <auto Numerical>
+bool compare(const char *name, wows_shell::shellCalc &calc,
+             const wows_shell::shellParams &sp) {
+    using namespace wows_shell;
+    shell fine(sp, "fine"), hybrid(sp, "hybrid");
+    const std::size_t fineSteps = countSteps<Numerical, false>(calc, fine);
+    const std::size_t hybridSteps = countSteps<Numerical, true>(calc, hybrid);
+    std::cout << name << " - steps fine: " << fineSteps
+              << " hybrid: " << hybridSteps << " max relative deviation: "
+              << maxRelativeDeviation(fine, hybrid) << "\n";
+    return hybridSteps < fineSteps;
+}
+
+int main() {
+    using namespace wows_shell;
+    shellCalc calc;
+    calc.set_max(45);
+    shellParams sp = {.460, 780, .292, 1460, 2574, 6, .033, 76, 45, 60, 0};
+
+    bool fewer = true;
+    std::cout << "Yamato 0-45 degrees, hybridHeight 500 m\n";
+    fewer &= compare<numerical::forwardEuler>("ForwardEuler", calc, sp);
+    fewer &= compare<numerical::rungeKutta2>("RungeKutta2", calc, sp);
+    fewer &= compare<numerical::rungeKutta4>("RungeKutta4", calc, sp);
+
+    // Flat fire never climbs above the default hybridHeight
+    calc.set_max(5);
+    std::cout << "Yamato 0-5 degrees, hybridHeight 500 m\n";
+    compare<numerical::rungeKutta4>("RungeKutta4", calc, sp);
+    calc.set_hybridHeight(50);
+    std::cout << "Yamato 0-5 degrees, hybridHeight 50 m\n";
+    fewer &= compare<numerical::rungeKutta4>("RungeKutta4", calc, sp);
+
+    if (!fewer) std::cout << "Hybrid did not reduce the step count\n";
+    return fewer ? 0 : 1;
+}
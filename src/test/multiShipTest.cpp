@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <vector>
 
 #include "../shellCPP.hpp"
@@ -44,6 +46,9 @@ int main() {
     ships.emplace_back(.32, 830, .4098, 525, 2600, 6, 0.033, 53, 45, 60.0, 0,
                        "Giulio Cesare");
 
+    // Uncalculated copies for the fleet call below
+    std::vector<wows_shell::shell> fleet(ships);
+
     wows_shell::shellCalc calculator;
     // calculator.set_dt_min(.1);
     // calculator.set_precision(.01);
@@ -70,6 +75,25 @@ int main() {
         
     }
 
+    // The same fleet in one call - lanes are refilled across ships
+    calculator.set_laneRefill(true);
+    calculator.set_cacheSize(0);  // integrate again instead of copying
+    calculator
+        .calculateImpact<false, wows_shell::numerical::forwardEuler, false>(
+            fleet.begin(), fleet.end());
+    double deviation = 0;
+    for (std::size_t i = 0; i < ships.size(); ++i) {
+        for (double dist : dists) {
+            const auto column = wows_shell::impact::impactIndices::
+                effectivePenetrationHorizontalNormalized;
+            deviation = std::max(
+                deviation,
+                std::fabs(fleet[i].interpolateDistanceImpact(dist, column) -
+                          ships[i].interpolateDistanceImpact(dist, column)));
+        }
+    }
+    std::cout << "Fleet max deviation: " << deviation << "\n";
+
     // ships.emplace_back(, , , , , , , , 45, 60.0,
     //                   0, "");
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../shellCPP.hpp"
+
+// Work stealing pool - every index of parallelFor runs exactly once and
+// concurrent callers on one calculator get the results of serial calls
+
+bool eachIndexOnce(wows_shell::utility::threadPool &pool,
+                   const std::size_t length, const std::size_t threads,
+                   const std::size_t grain) {
+    std::vector<std::atomic_size_t> runs(length);
+    for (auto &r : runs) r = 0;
+    pool.parallelFor(length, threads, grain,
+                     [&](const std::size_t i) { ++runs[i]; });
+    for (const auto &r : runs) {
+        if (r != 1) return false;
+    }
+    return true;
+}
+
+bool sameImpact(wows_shell::shell &reference, wows_shell::shell &compared) {
+    if (reference.impactSize != compared.impactSize) return false;
+    for (std::size_t i = 0; i < reference.impactSize; ++i) {
+        for (std::size_t j = 0; j < wows_shell::impact::maxColumns; ++j) {
+            const double r = reference.get_impact(i, j),
+                         c = compared.get_impact(i, j);
+            if (r != c && !(std::isnan(r) && std::isnan(c))) return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    using namespace wows_shell;
+    bool passed = true;
+
+    for (const std::size_t poolSize : {1, 2, 3, 4, 8}) {
+        utility::threadPool pool(poolSize);
+        for (const std::size_t length : {0, 1, 2, 7, 64, 1000, 4097}) {
+            for (const std::size_t threads : {1, 2, 4, 16}) {
+                for (const std::size_t grain : {1, 3, 64}) {
+                    if (!eachIndexOnce(pool, length, threads, grain)) {
+                        std::cout << "parallelFor failed - pool " << poolSize
+                                  << " length " << length << " threads "
+                                  << threads << " grain " << grain << "\n";
+                        passed = false;
+                    }
+                }
+            }
+        }
+    }
+
+    // Several callers splitting ranges on one pool at once
+    {
+        utility::threadPool pool(4);
+        std::atomic_bool concurrentPassed{true};
+        std::vector<std::thread> callers;
+        for (std::size_t c = 0; c < 4; ++c) {
+            callers.emplace_back([&, c] {
+                for (std::size_t k = 0; k < 50; ++k) {
+                    if (!eachIndexOnce(pool, 1000 + c * 37 + k, 4, 1 + k % 8))
+                        concurrentPassed = false;
+                }
+            });
+        }
+        for (auto &t : callers) t.join();
+        if (!concurrentPassed) {
+            std::cout << "Concurrent parallelFor failed\n";
+            passed = false;
+        }
+    }
+
+    // Concurrent calls sharing one calculator
+    {
+        shellCalc calc(4);
+        calc.set_max(30);
+        const std::vector<shellParams> params = {
+            {.460, 780, .292, 1460, 2574, 6, .033, 76, 45, 60, 0},
+            {.406, 762, .352, 1225, 2520, 6, .033, 69, 45, 60, 0},
+            {.203, 853, .3210, 118.0, 2846, 7.0, .033, 34, 60, 67.5, 0},
+            {.152, 950, .3210, 55.00, 2216, 8.5, .025, 25, 45, 60.0, 0}};
+        std::vector<shell> reference, compared;
+        for (const shellParams &sp : params) {
+            reference.emplace_back(sp, "reference");
+            compared.emplace_back(sp, "compared");
+        }
+        for (shell &s : reference) {
+            calc.calculateImpact<false, numerical::rungeKutta4, false>(s, 1);
+        }
+        calc.set_cacheSize(0);
+        std::vector<std::thread> callers;
+        for (std::size_t c = 0; c < compared.size(); ++c) {
+            callers.emplace_back([&, c] {
+                calc.calculateImpact<false, numerical::rungeKutta4, false>(
+                    compared[c], 4);
+            });
+        }
+        for (auto &t : callers) t.join();
+        for (std::size_t c = 0; c < compared.size(); ++c) {
+            if (!sameImpact(reference[c], compared[c])) {
+                std::cout << "Concurrent calculateImpact " << c
+                          << " differs from the serial result\n";
+                passed = false;
+            }
+        }
+    }
+
+    std::cout << (passed ? "Thread pool test passed\n"
+                         : "Thread pool test failed\n");
+    return passed ? 0 : 1;
+}
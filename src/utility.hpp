@@ -1,6 +1,7 @@
 #pragma once
 
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
@@ -8,14 +9,19 @@
 #include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 namespace wows_shell {
@@ -93,15 +99,15 @@ std::string base85Encode(const T& in, const bool pad = false) {
     return output;
 }
 
-double pdf(const double& x) {
+inline double pdf(const double& x) {
     return (1.0l / sqrt(2.0l * M_PI)) * exp(-0.5l * x * x);
 }
 
-double cdf(const double& x) { return (1 + erf(x / sqrt(2))) / 2; }
+inline double cdf(const double& x) { return (1 + erf(x / sqrt(2))) / 2; }
 
 // https://people.maths.ox.ac.uk/gilesm/files/gems_erfinv.pdf
 // This is only the single precision version but it's good enough
-double MBG_erfinv(double x) {
+inline double MBG_erfinv(double x) {
     double p;
     double w = -log((1.0l - x) * (1.0l + x));
     if (w < 5.000000l) {
@@ -130,75 +136,398 @@ double MBG_erfinv(double x) {
     return p * x;
 }
 
-double invCDF(double x) { return sqrt(2) * MBG_erfinv(2 * x - 1); }
+inline double invCDF(double x) { return sqrt(2) * MBG_erfinv(2 * x - 1); }
 
+// Work stealing thread pool - every worker has its own task deque and
+// sleeps on its own condition variable. Workers run their own tasks oldest
+// first and take the newest tasks of other workers when they run out.
 class threadPool {
    private:
+    struct worker {
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+        bool sleeping = false, woken = false;
+    };
+
+    // Fork-join state of start - late tasks skip a closed job
+    struct job {
+        std::mutex m;
+        std::condition_variable cv;
+        std::size_t active = 0;
+        bool closed = false;
+    };
+
+    std::vector<std::unique_ptr<worker>> workers;
     std::vector<std::thread> threads;
-    std::function<void(std::size_t)> f;
+    std::atomic_size_t nextWorker{0};
+    std::atomic_bool stop{false};
+
+    bool popOwn(worker& w, std::function<void()>& task) {
+        std::lock_guard<std::mutex> lk(w.m);
+        if (w.tasks.empty()) return false;
+        task = std::move(w.tasks.front());
+        w.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(const std::size_t i, std::function<void()>& task) {
+        for (std::size_t k = 1; k < workers.size(); ++k) {
+            worker& victim = *workers[(i + k) % workers.size()];
+            std::lock_guard<std::mutex> lk(victim.m);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void run(const std::size_t i) {
+        worker& w = *workers[i];
+        for (;;) {
+            std::function<void()> task;
+            if (popOwn(w, task) || steal(i, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(w.m);
+            if (stop) return;
+            if (!w.tasks.empty()) continue;
+            w.sleeping = true;
+            w.cv.wait(lk, [&] { return stop || w.woken || !w.tasks.empty(); });
+            w.sleeping = w.woken = false;
+        }
+    }
 
-    std::condition_variable cv, cv_finished;
-    std::mutex m_;
-    std::atomic_size_t busy;
-    bool ready = false, stop = false;
+    // Wakes a sleeping worker other than busy to steal - false if none
+    bool wakeThief(const std::size_t busy) {
+        for (std::size_t k = 1; k < workers.size(); ++k) {
+            worker& w = *workers[(busy + k) % workers.size()];
+            std::lock_guard<std::mutex> lk(w.m);
+            if (w.sleeping && !w.woken) {
+                w.woken = true;
+                w.cv.notify_one();
+                return true;
+            }
+        }
+        return false;
+    }
 
    public:
     threadPool(std::size_t numThreads = std::thread::hardware_concurrency()) {
-        threads.reserve(numThreads - 1);
-        for (std::size_t i = 1; i < numThreads; ++i) {
-            threads.emplace_back([&, i]() {
-                for (;;) {
-                    std::unique_lock<std::mutex> lk(m_);
-                    cv.wait(lk, [&] { return ready || stop; });
-
-                    if (stop) return;
-                    if (ready && f) {
-                        busy.fetch_add(1, std::memory_order_acquire);
-                        lk.unlock();
-                        f(i);
-                        auto current =
-                            busy.fetch_sub(1, std::memory_order_release);
-                        if (current == 1) {  // Double check locking for speed
-                            lk.lock();
-                            cv_finished.notify_one();
-                        }
-                    }
-                }
-            });
+        const std::size_t n = numThreads > 1 ? numThreads - 1 : 0;
+        workers.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            workers.push_back(std::make_unique<worker>());
+        }
+        threads.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            threads.emplace_back([this, i]() { run(i); });
+        }
+    }
+
+    // Threads including the caller
+    std::size_t size() const noexcept { return threads.size() + 1; }
+
+    // Queues a task on the next worker - run inline without workers
+    void submit(std::function<void()> task) {
+        if (workers.empty()) {
+            task();
+            return;
+        }
+        const std::size_t i = nextWorker.fetch_add(1) % workers.size();
+        worker& w = *workers[i];
+        bool asleep;
+        {
+            std::lock_guard<std::mutex> lk(w.m);
+            w.tasks.push_back(std::move(task));
+            asleep = w.sleeping;
+        }
+        if (asleep) {
+            w.cv.notify_one();
+        } else {
+            wakeThief(i);
         }
     }
 
+    // Calls tf(0) on the calling thread and tf(1 ... helpers) on up to
+    // helpers others. Returns once tf(0) and every started call returned -
+    // calls that haven't started by then are skipped, the caller has done
+    // their share.
     template <typename ThreadFunction>
-    void start(ThreadFunction tf) {
+    void start(ThreadFunction tf,
+               const std::size_t helpers =
+                   std::numeric_limits<std::size_t>::max()) {
         static_assert(std::is_invocable_v<ThreadFunction, std::size_t>,
                       "Function has an incorrect signature - requires "
                       "void(std::size_t).");
-        {
-            std::lock_guard<std::mutex> lk(m_);
-            f = tf, ready = true;
-        }
-        cv.notify_all();
-        tf(0);  // utilize main thread
-        {
-            std::unique_lock<std::mutex> lk(m_);
-            cv_finished.wait(lk, [&] {
-                return (busy.load(std::memory_order_acquire) == 0);
+        const std::size_t wanted = std::min(helpers, threads.size());
+        auto j = std::make_shared<job>();
+        for (std::size_t id = 1; id <= wanted; ++id) {
+            submit([j, tf, id]() {
+                {
+                    std::lock_guard<std::mutex> lk(j->m);
+                    if (j->closed) return;
+                    ++j->active;
+                }
+                tf(id);
+                std::lock_guard<std::mutex> lk(j->m);
+                if (--j->active == 0) j->cv.notify_all();
             });
-            ready = false;
         }
+        tf(0);  // utilize calling thread
+        std::unique_lock<std::mutex> lk(j->m);
+        j->closed = true;
+        j->cv.wait(lk, [&] { return j->active == 0; });
+    }
+
+    // f(index) for every index in [0, length) on up to threads threads. The
+    // range is split evenly between them and taken grain indices at a time.
+    // A thread that runs out steals the back half of another's remaining
+    // range.
+    template <typename F>
+    void parallelFor(const std::size_t length, std::size_t threads,
+                     const std::size_t grain, F f) {
+        threads = std::min(threads, size());
+        if (threads <= 1) {
+            for (std::size_t i = 0; i < length; ++i) f(i);
+            return;
+        }
+        struct alignas(64) part {
+            std::mutex m;
+            std::size_t begin, end;
+        };
+        std::vector<part> parts(threads);
+        for (std::size_t k = 0; k < threads; ++k) {
+            parts[k].begin = length * k / threads;
+            parts[k].end = length * (k + 1) / threads;
+        }
+        std::atomic_size_t slots{0};
+        start(
+            [&](const std::size_t) {
+                const std::size_t me = slots.fetch_add(1);
+                part& mine = parts[me];
+                for (;;) {
+                    std::size_t begin, end;
+                    {
+                        std::lock_guard<std::mutex> lk(mine.m);
+                        begin = mine.begin;
+                        end = std::min(mine.end, begin + grain);
+                        mine.begin = end;
+                    }
+                    if (begin < end) {
+                        for (std::size_t i = begin; i < end; ++i) f(i);
+                        continue;
+                    }
+                    bool stolen = false;
+                    for (std::size_t k = 1; k < threads && !stolen; ++k) {
+                        part& victim = parts[(me + k) % threads];
+                        std::lock_guard<std::mutex> lk(victim.m);
+                        const std::size_t left = victim.end - victim.begin;
+                        if (left == 0) continue;
+                        begin = left > grain ? victim.begin + left / 2
+                                             : victim.begin;
+                        end = victim.end;
+                        victim.end = begin;
+                        stolen = true;
+                    }
+                    if (!stolen) return;
+                    std::lock_guard<std::mutex> lk(mine.m);
+                    mine.begin = begin, mine.end = end;
+                }
+            },
+            threads - 1);
     }
 
     ~threadPool() {
-        {
-            std::lock_guard<std::mutex> lk(m_);
-            f = [](const std::size_t i) {};
-            // pass in an empty function just in case
-            stop = true, ready = false;
+        stop = true;
+        for (auto& w : workers) {
+            // Taking the lock orders stop before a worker's next wait
+            std::lock_guard<std::mutex> lk(w->m);
+            w->cv.notify_all();
         }
-        cv.notify_all();
         for (auto& t : threads) t.join();
     }
 };
 
+// Handle of a job queued on a threadPool. Continuations added with then
+// are queued once it finishes, so no thread waits in between - the pool
+// must outlive them. Waiting on a handle from inside the pool can deadlock
+// it.
+class completion {
+   private:
+    struct state {
+        std::mutex m;
+        std::condition_variable cv;
+        bool done = false;
+        std::exception_ptr error;
+        // Called with the error of this job
+        std::vector<std::function<void(std::exception_ptr)>> continuations;
+        threadPool* pool;
+    };
+    std::shared_ptr<state> st;
+
+    explicit completion(threadPool& pool) : st(std::make_shared<state>()) {
+        st->pool = &pool;
+    }
+
+    static void finish(state& s, std::exception_ptr error) {
+        std::vector<std::function<void(std::exception_ptr)>> continuations;
+        {
+            std::lock_guard<std::mutex> lk(s.m);
+            s.done = true;
+            s.error = error;
+            continuations.swap(s.continuations);
+        }
+        s.cv.notify_all();
+        for (auto& c : continuations) {
+            s.pool->submit([c = std::move(c), error]() { c(error); });
+        }
+    }
+
+    // Runs f and finishes next - f is skipped if the previous job failed
+    template <typename F>
+    static std::function<void(std::exception_ptr)> body(
+        std::shared_ptr<state> next, F f) {
+        return [next, f](std::exception_ptr previous) mutable {
+            std::exception_ptr error = previous;
+            if (!error) {
+                try {
+                    f();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            finish(*next, error);
+        };
+    }
+
+    template <typename F>
+    friend completion async(threadPool& pool, F f);
+
+   public:
+    completion() = default;
+
+    bool valid() const noexcept { return static_cast<bool>(st); }
+    bool ready() const {
+        std::lock_guard<std::mutex> lk(st->m);
+        return st->done;
+    }
+    void wait() const {
+        std::unique_lock<std::mutex> lk(st->m);
+        st->cv.wait(lk, [&] { return st->done; });
+    }
+    // Waits and rethrows what the job (or one it was chained to) threw
+    void get() const {
+        wait();
+        if (st->error) std::rethrow_exception(st->error);
+    }
+
+    // f() queued on the same pool once this job finishes
+    template <typename F>
+    completion then(F f) const {
+        static_assert(std::is_invocable_v<F>,
+                      "Function has an incorrect signature - requires "
+                      "void().");
+        completion next(*st->pool);
+        std::unique_lock<std::mutex> lk(st->m);
+        if (!st->done) {
+            st->continuations.push_back(body(next.st, std::move(f)));
+            return next;
+        }
+        std::exception_ptr error = st->error;
+        lk.unlock();
+        st->pool->submit(
+            [c = body(next.st, std::move(f)), error]() { c(error); });
+        return next;
+    }
+};
+
+// f() queued on pool - run inline if the pool has no workers
+template <typename F>
+completion async(threadPool& pool, F f) {
+    static_assert(std::is_invocable_v<F>,
+                  "Function has an incorrect signature - requires void().");
+    completion job(pool);
+    auto c = completion::body(job.st, std::move(f));
+    pool.submit([c]() { c(nullptr); });
+    return job;
+}
+
+// Thread safe least recently used cache - values are shared so that a hit
+// doesn't copy while holding the lock. Capacity 0 disables it.
+template <typename Key, typename Value>
+class lruCache {
+   private:
+    using entry = std::pair<Key, std::shared_ptr<const Value>>;
+    std::list<entry> entries;  // most recently used first
+    std::unordered_map<Key, typename std::list<entry>::iterator> index;
+    std::size_t capacity;
+    mutable std::mutex m_;
+    std::atomic_size_t hits{0}, misses{0};
+
+    void evict() {
+        while (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+   public:
+    lruCache(const std::size_t capacity = 0) : capacity(capacity) {}
+
+    std::shared_ptr<const Value> find(const Key& key) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (capacity == 0) return nullptr;
+        auto it = index.find(key);
+        if (it == index.end()) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        hits.fetch_add(1, std::memory_order_relaxed);
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    void insert(const Key& key, std::shared_ptr<const Value> value) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (capacity == 0) return;
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->second->second = std::move(value);
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        entries.emplace_front(key, std::move(value));
+        index.emplace(key, entries.begin());
+        evict();
+    }
+
+    void set_capacity(const std::size_t capacity) {
+        std::lock_guard<std::mutex> lk(m_);
+        this->capacity = capacity;
+        evict();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lk(m_);
+        entries.clear();
+        index.clear();
+        hits = 0, misses = 0;
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return entries.size();
+    }
+    std::size_t get_capacity() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return capacity;
+    }
+    std::size_t get_hits() const { return hits.load(); }
+    std::size_t get_misses() const { return misses.load(); }
+};
+
 }  // namespace utility
 }  // namespace wows_shell
\ No newline at end of file